@@ -0,0 +1,111 @@
+//
+//  basic_tcp_server.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef basic_tcp_server_h
+#define basic_tcp_server_h
+
+#include "socket.h"
+
+namespace mysocket {
+    // Typedef
+
+    // Options a basic_tcp_server fixes at compile time, whatever its constructor is given; tcp_server::options'
+    // defaults. Derive and redeclare the ones to change
+    struct default_policy {
+        // Member Fields
+
+        // Threading
+        static constexpr tcp_server::io_mode mode = tcp_server::THREADED;
+        static constexpr bool                thread_per_core = false;
+        static constexpr size_t              threads = 0;
+
+        // Timeouts, in milliseconds
+        static constexpr size_t              idle_timeout = 0;
+        static constexpr size_t              linger_timeout = 30000;
+
+        // Buffer sizes, in bytes
+        static constexpr size_t              high_watermark = 1 << 20;
+        static constexpr size_t              low_watermark = 1 << 18;
+        static constexpr size_t              max_output = 0;
+        static constexpr int                 receive_buffer = 0;
+        static constexpr int                 send_buffer = 0;
+    };
+
+    // A tcp_server whose handler is a type rather than a std::function: held by value and called directly, so the
+    // compiler can inline it, and whatever it calls, into the server's dispatch. Handler is called with each new
+    // connection, like tcp_server's handler; if it also has on_readable(connection*), that is called for new input,
+    // in place of connection::on_readable() callbacks, with per-connection state kept in connection::context().
+    // Both run on every loop at once. tcp_server remains the type-erased server, and the only one the handler sees
+    template <typename Handler, typename Policy = default_policy>
+    struct basic_tcp_server: public tcp_server {
+        // Constructors
+
+        basic_tcp_server(const int port, const Handler handler): basic_tcp_server(port, handler, options()) { }
+
+        basic_tcp_server(const int port, const Handler handler, const struct options options): _static_handler(handler) {
+            this->_inet(port);
+            this->_serve(options);
+        }
+
+        // See tcp_server(path, ...)
+        basic_tcp_server(const std::string path, const Handler handler, const struct options options): _static_handler(handler) {
+            this->_unix(path);
+            this->_serve(options);
+        }
+
+        // See tcp_server(file_descriptors, ...)
+        basic_tcp_server(const std::vector<int> file_descriptors, const Handler handler, const struct options options): _static_handler(handler) {
+            this->_adopt(file_descriptors);
+            this->_serve(options);
+        }
+
+        // See tcp_server(handler, options)
+        basic_tcp_server(const Handler handler, const struct options options): _static_handler(handler) {
+            this->_serve(options);
+        }
+    private:
+        // Constructors
+
+        ~basic_tcp_server() { }
+
+        // Member Fields
+
+        Handler _static_handler;
+
+        // Member Functions
+
+        static void _on_readable(tcp_server* server, class connection* connection) {
+            static_cast<basic_tcp_server*>(server)->_static_handler.on_readable(connection);
+        }
+
+        // Applies the policy over the options, then starts, once the handler is in place
+        void        _serve(const struct options options) {
+            struct options policy_options = options;
+
+            policy_options.high_watermark = Policy::high_watermark;
+            policy_options.idle_timeout = Policy::idle_timeout;
+            policy_options.linger_timeout = Policy::linger_timeout;
+            policy_options.low_watermark = Policy::low_watermark;
+            policy_options.max_output = Policy::max_output;
+            policy_options.mode = Policy::mode;
+            policy_options.receive_buffer = Policy::receive_buffer;
+            policy_options.send_buffer = Policy::send_buffer;
+            policy_options.thread_per_core = Policy::thread_per_core;
+            policy_options.threads = Policy::threads;
+
+            if constexpr (requires (Handler& handler, class connection* connection) { handler.on_readable(connection); })
+                this->_static_readable = _on_readable;
+
+            // Captures just this, so std::function keeps it inline; called once per connection
+            this->_start([this](class connection* connection) {
+                this->_static_handler(connection);
+            }, policy_options);
+        }
+    };
+}
+
+#endif /* basic_tcp_server_h */
@@ -0,0 +1,118 @@
+//
+//  buffer.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "buffer.h"
+
+namespace mysocket {
+    // Constructors
+
+    buffer::buffer() { }
+
+    buffer::~buffer() {
+        this->_reallocate(0);
+    }
+
+    // Member Functions
+
+    void buffer::_reallocate(const size_t capacity) {
+        char*  data = NULL;
+        size_t size = capacity ? this->size() : 0;
+
+        if (capacity) {
+            data = capacity <= buffer_pool::BUFFER_SIZE ? buffer_pool::acquire() : new char[capacity];
+
+            if (size)
+                memcpy(data, this->data(), size);
+        }
+
+        if (this->_capacity == buffer_pool::BUFFER_SIZE)
+            buffer_pool::release(this->_data);
+        else
+            delete[] this->_data;
+
+        this->_capacity = capacity == 0 ? 0 : std::max(capacity, buffer_pool::BUFFER_SIZE);
+        this->_data = data;
+        this->_end = size;
+        this->_start = 0;
+    }
+
+    void buffer::append(const char* data, const size_t len) {
+        memcpy(this->prepare(len), data, len);
+
+        this->commit(len);
+    }
+
+    size_t buffer::capacity() const {
+        return this->_capacity;
+    }
+
+    void buffer::clear() {
+        this->_start = this->_end = 0;
+    }
+
+    void buffer::commit(const size_t len) {
+        this->_end += len;
+    }
+
+    void buffer::consume(const size_t len) {
+        this->_start += std::min(len, this->size());
+
+        // Rewind when drained so the next read starts at the front
+        if (this->_start == this->_end)
+            this->clear();
+    }
+
+    const char* buffer::data() const {
+        return this->_data + this->_start;
+    }
+
+    bool buffer::empty() const {
+        return this->size() == 0;
+    }
+
+    char* buffer::prepare(const size_t len) {
+        if (this->writable() < len) {
+            if (this->_capacity - this->size() >= len) {
+                // Enough room once the consumed prefix is reclaimed
+                memmove(this->_data, this->data(), this->size());
+
+                this->_end = this->size();
+                this->_start = 0;
+            } else
+                this->_reallocate(std::max(this->_capacity * 2, this->size() + len));
+        }
+
+        return this->_data + this->_end;
+    }
+
+    void buffer::shrink(const size_t capacity) {
+        if (this->empty())
+            return this->_reallocate(0);
+
+        // Anything smaller is a block anyway
+        size_t target = std::max(capacity, buffer_pool::BUFFER_SIZE);
+
+        if (this->_capacity > target && this->size() <= target)
+            this->_reallocate(target);
+    }
+
+    size_t buffer::size() const {
+        return this->_end - this->_start;
+    }
+
+    std::string buffer::str() const {
+        return std::string(this->data(), this->size());
+    }
+
+    std::string_view buffer::view() const {
+        return std::string_view(this->data(), this->size());
+    }
+
+    size_t buffer::writable() const {
+        return this->_capacity - this->_end;
+    }
+}
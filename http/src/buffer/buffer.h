@@ -0,0 +1,75 @@
+//
+//  buffer.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef buffer_h
+#define buffer_h
+
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstring>      // memcpy, memmove
+#include <string>
+#include <string_view>
+
+namespace mysocket {
+    // Contiguous byte buffer: bytes are consumed from the front and appended at the back. Up to
+    // buffer_pool::BUFFER_SIZE, storage is a block borrowed from the pool; beyond it, from the heap
+    struct buffer {
+        // Constructors
+
+        buffer();
+
+        buffer(const buffer& value) = delete;
+
+        ~buffer();
+
+        // Member Functions
+
+        void             append(const char* data, const size_t len);
+
+        size_t           capacity() const;
+
+        void             clear();
+
+        // Marks len bytes written through prepare() as data
+        void             commit(const size_t len);
+
+        void             consume(const size_t len);
+
+        const char*      data() const;
+
+        bool             empty() const;
+
+        // Returns space for at least len more bytes, compacting or growing as needed
+        char*            prepare(const size_t len);
+
+        // Releases storage beyond capacity (at least a block) once the data fits, and all of it when empty, giving
+        // a block back to the pool
+        void             shrink(const size_t capacity);
+
+        size_t           size() const;
+
+        std::string      str() const;
+
+        std::string_view view() const;
+
+        size_t           writable() const;
+    private:
+        // Member Fields
+
+        // buffer_pool::BUFFER_SIZE exactly for a block; more for the heap
+        size_t _capacity = 0;
+        char*  _data = NULL;
+        size_t _end = 0;
+        size_t _start = 0;
+
+        // Member Functions
+
+        void   _reallocate(const size_t capacity);
+    };
+}
+
+#endif /* buffer_h */
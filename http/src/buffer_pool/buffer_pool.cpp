@@ -0,0 +1,127 @@
+//
+//  buffer_pool.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "buffer_pool.h"
+#include <new>          // bad_alloc
+
+namespace mysocket {
+    // Member Fields
+
+    std::atomic<size_t>             buffer_pool::_blocks = 0;
+    thread_local buffer_pool::cache buffer_pool::_cache;
+    std::atomic<bool>               buffer_pool::_configured = false;
+    std::vector<char*>              buffer_pool::_free;
+    std::atomic<size_t>             buffer_pool::_free_size = 0;
+    std::atomic<size_t>             buffer_pool::_hugepage_slabs = 0;
+    std::atomic<size_t>             buffer_pool::_in_use = 0;
+    std::mutex                      buffer_pool::_mutex;
+    struct buffer_pool::options     buffer_pool::_options;
+    std::atomic<size_t>             buffer_pool::_slabs = 0;
+
+    // Constructors
+
+    buffer_pool::cache::~cache() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _free.insert(_free.end(), this->blocks.begin(), this->blocks.end());
+        _free_size.store(_free.size());
+    }
+
+    // Member Functions
+
+    void buffer_pool::_refill(cache& cache) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Settled for good by the first block taken
+        _configured.store(true);
+
+        if (_free.empty()) {
+            size_t slab_size = std::max(_options.slab_size / BUFFER_SIZE, (size_t) 1) * BUFFER_SIZE;
+            void*  slab = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+            if (_options.hugepages && (slab = mmap(NULL, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)) != MAP_FAILED)
+                _hugepage_slabs.fetch_add(1);
+#endif
+
+            if (slab == MAP_FAILED) {
+                if ((slab = mmap(NULL, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+                    throw std::bad_alloc();
+
+#if defined(MADV_HUGEPAGE)
+                // None reserved; transparent hugepages, best effort
+                if (_options.hugepages)
+                    madvise(slab, slab_size, MADV_HUGEPAGE);
+#endif
+            }
+
+            _slabs.fetch_add(1);
+            _blocks.fetch_add(slab_size / BUFFER_SIZE);
+
+            for (size_t offset = 0; offset < slab_size; offset += BUFFER_SIZE)
+                _free.push_back((char *)slab + offset);
+        }
+
+        size_t count = std::min(_free.size(), std::max(_options.cache_size / 2, (size_t) 1));
+
+        cache.blocks.insert(cache.blocks.end(), _free.end() - count, _free.end());
+
+        _free.resize(_free.size() - count);
+        _free_size.store(_free.size());
+    }
+
+    char* buffer_pool::acquire() {
+        if (_cache.blocks.empty())
+            _refill(_cache);
+
+        char* block = _cache.blocks.back();
+
+        _cache.blocks.pop_back();
+        _in_use.fetch_add(1, std::memory_order_relaxed);
+
+        return block;
+    }
+
+    void buffer_pool::configure(const struct options options) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_configured.load())
+            _options = options;
+    }
+
+    void buffer_pool::release(char* block) {
+        _cache.blocks.push_back(block);
+        _in_use.fetch_sub(1, std::memory_order_relaxed);
+
+        if (_cache.blocks.size() <= std::max(_options.cache_size, (size_t) 1))
+            return;
+
+        // Half back, so a thread that only frees, e.g. one closing what another loop's reads filled, stays bounded
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t                      count = _cache.blocks.size() / 2;
+
+        _free.insert(_free.end(), _cache.blocks.end() - count, _cache.blocks.end());
+        _free_size.store(_free.size());
+
+        _cache.blocks.resize(_cache.blocks.size() - count);
+    }
+
+    struct buffer_pool::statistics buffer_pool::stats() {
+        struct statistics result;
+
+        result.blocks = _blocks.load();
+        result.free = _free_size.load();
+        result.hugepage_slabs = _hugepage_slabs.load();
+        result.in_use = _in_use.load();
+        result.slabs = _slabs.load();
+
+        // What is neither lent out nor shared; approximate while threads are busy
+        result.cached = result.blocks - std::min(result.blocks, result.in_use + result.free);
+
+        return result;
+    }
+}
@@ -0,0 +1,99 @@
+//
+//  buffer_pool.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef buffer_pool_h
+#define buffer_pool_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <sys/mman.h>   // mmap, madvise
+#include <vector>
+
+namespace mysocket {
+    // Fixed-size I/O blocks shared by the whole process, carved from large slabs and cached per thread, so taking and
+    // giving one back is usually a push or pop with no lock. Buffers hold a block only while they hold data, so memory
+    // follows the connections with input or output in flight, not the ones open
+    struct buffer_pool {
+        // Typedef
+
+        struct options {
+            // Blocks each thread keeps; past it, half go back to the shared list
+            size_t cache_size = 64;
+            // Linux: back slabs with explicit hugepages (MAP_HUGETLB) where some are reserved (vm.nr_hugepages), and
+            // otherwise ask for transparent ones, so a few TLB entries cover every buffer
+            bool   hugepages = false;
+            // Bytes carved at a time; a multiple of the hugepage size for hugepages to apply
+            size_t slab_size = 2 << 20;
+        };
+
+        struct statistics {
+            // Carved so far; the pool never gives memory back
+            size_t blocks = 0;
+            // Idle in threads' caches
+            size_t cached = 0;
+            // Idle in the shared list
+            size_t free = 0;
+            // Slabs backed by explicit hugepages
+            size_t hugepage_slabs = 0;
+            // Lent out; over blocks, the occupancy
+            size_t in_use = 0;
+            size_t slabs = 0;
+        };
+
+        // Member Fields
+
+        // One TLS record, or a read's worth
+        static constexpr size_t BUFFER_SIZE = 16384;
+
+        // Member Functions
+
+        // A block of BUFFER_SIZE bytes; throws std::bad_alloc once memory runs out
+        static char*             acquire();
+
+        // Before the first acquire(), e.g. at startup; ignored afterwards
+        static void              configure(const struct options options);
+
+        static void              release(char* block);
+
+        static struct statistics stats();
+    private:
+        // Typedef
+
+        // Blocks this thread may take and give back without a lock; returned to the shared list when the thread exits
+        struct cache {
+            // Constructors
+
+            ~cache();
+
+            // Member Fields
+
+            std::vector<char*> blocks;
+        };
+
+        // Member Fields
+
+        static std::atomic<size_t>   _blocks;
+        static thread_local cache    _cache;
+        static std::atomic<bool>     _configured;
+        static std::vector<char*>    _free;
+        static std::atomic<size_t>   _free_size;
+        static std::atomic<size_t>   _hugepage_slabs;
+        static std::atomic<size_t>   _in_use;
+        static std::mutex            _mutex;
+        static struct options        _options;
+        static std::atomic<size_t>   _slabs;
+
+        // Member Functions
+
+        // Moves up to half a cache's worth from the shared list into this thread's cache, carving a slab if it is empty
+        static void              _refill(cache& cache);
+    };
+}
+
+#endif /* buffer_pool_h */
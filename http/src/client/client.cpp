@@ -0,0 +1,351 @@
+//
+//  client.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "client.h"
+
+namespace http {
+    // Non-Member Functions
+
+    // Safe to send again if the response was lost (RFC 9110, section 9.2.2)
+    bool _idempotent(request& request) {
+        static const std::set<std::string> methods = { "delete", "get", "head", "options", "put", "trace" };
+
+        return methods.count(tolowerstr(request.method()));
+    }
+
+    std::string _key(const std::string host, const int port) {
+        return host + ":" + std::to_string(port);
+    }
+
+    std::string _serialize(const std::string host, const int port, request& request) {
+        std::ostringstream oss;
+        header::map        headers = request.headers();
+        bool               framed = false,
+                           hosted = false;
+
+        oss << toupperstr(request.method()) << " " << (request.url().empty() ? "/" : request.url()) << " " << http_version() << "\r\n";
+
+        for (const auto& [key, value]: headers) {
+            std::string name = tolowerstr(key);
+
+            framed = framed || name == "content-length" || name == "transfer-encoding";
+            hosted = hosted || name == "host";
+
+            oss << key << ": " << value.str() << "\r\n";
+        }
+
+        // Unix domain socket paths name no host
+        if (!hosted && (host.empty() || host[0] == '/' || host[0] == '@'))
+            oss << "Host: localhost\r\n";
+        else if (!hosted)
+            oss << "Host: " << host << (port == 80 ? "" : ":" + std::to_string(port)) << "\r\n";
+
+        if (!framed && request.body().length())
+            oss << "Content-Length: " << request.body().length() << "\r\n";
+
+        oss << "\r\n" << request.body();
+
+        return oss.str();
+    }
+
+    // Constructors
+
+    client::client() { }
+
+    client::client(const struct options options) {
+        this->_options = options;
+    }
+
+    client::~client() { }
+
+    // Member Functions
+
+    client::connection* client::_acquire(const std::string host, const int port, bool& reused) {
+        this->_mutex.lock();
+
+        std::vector<connection*>& idle = this->_idle[_key(host, port)];
+
+        if (idle.size()) {
+            connection* connection = idle.back();
+
+            idle.pop_back();
+
+            this->_stats.idle--;
+            this->_mutex.unlock();
+
+            reused = true;
+
+            return connection;
+        }
+
+        this->_mutex.unlock();
+
+        connection* connection = new struct connection();
+
+        try {
+            connection->socket = new mysocket::tcp_client(host, port, this->_options.connect_timeout);
+        } catch (mysocket::error& e) {
+            delete connection;
+
+            throw e;
+        }
+
+        // Only handshakes that completed
+        this->_mutex.lock();
+        this->_stats.connects++;
+        this->_mutex.unlock();
+
+        reused = false;
+
+        return connection;
+    }
+
+    void client::_discard(connection* connection) {
+        try {
+            connection->socket->close();
+        } catch (mysocket::error& e) { }
+
+        delete connection;
+    }
+
+    bool client::_fill(connection* connection) {
+        return connection->socket->recv(connection->input, this->_options.read_timeout) > 0;
+    }
+
+    client::response client::_read(connection* connection, const bool head, bool& keep_alive) {
+        response    result;
+        std::string version;
+
+        // Skip interim responses, e.g. 100 Continue
+        while (result.status / 100 == 1 || result.status == 0) {
+            std::string              line = this->_read_line(connection);
+            std::vector<std::string> status_line = split(line, " ");
+
+            if (status_line.size() < 2 || !starts_with(status_line[0], "HTTP/"))
+                throw http::error(UNKNOWN_ERROR, "Malformed response");
+
+            version = status_line[0];
+            result.status = parse_int(status_line[1]);
+            result.status_text = status_line.size() > 2 ? line.substr(status_line[0].length() + status_line[1].length() + 2) : "";
+            result.headers.clear();
+
+            for (line = this->_read_line(connection); line.length(); line = this->_read_line(connection)) {
+                size_t colon = line.find(':');
+
+                if (colon == std::string::npos)
+                    throw http::error(UNKNOWN_ERROR, "Malformed response");
+
+                std::string name = tolowerstr(trim(line.substr(0, colon))),
+                            value = trim(line.substr(colon + 1));
+
+                // Repeated headers fold into one list
+                result.headers[name] = result.headers[name].str().empty() ? value : result.headers[name].str() + ", " + value;
+            }
+        }
+
+        std::string connection_header = tolowerstr(result.headers["connection"].str());
+
+        keep_alive = version == http_version() ?
+            connection_header.find("close") == std::string::npos :
+            connection_header.find("keep-alive") != std::string::npos;
+
+        if (head || result.status == NO_CONTENT || result.status == 304)
+            return result;
+
+        if (tolowerstr(result.headers["transfer-encoding"].str()).find("chunked") != std::string::npos) {
+            while (true) {
+                // Extensions after ';' are ignored
+                std::string line = this->_read_line(connection),
+                            hex = trim_end(line.substr(0, line.find(';')));
+
+                // 1 to 16 hex digits, which stoull() would otherwise take with a sign, leading space or 0x
+                if (hex.empty() || hex.length() > 16 || !std::all_of(hex.begin(), hex.end(), [](const char c) {
+                    return isxdigit((unsigned char)c);
+                }))
+                    throw http::error(UNKNOWN_ERROR, "Malformed chunk");
+
+                size_t size = std::stoull(hex, NULL, 16);
+
+                // Or the size and its CRLF wrap around
+                if (size > SIZE_MAX - 2)
+                    throw http::error(UNKNOWN_ERROR, "Malformed chunk");
+
+                if (size == 0) {
+                    // Trailers
+                    while (this->_read_line(connection).length())
+                        continue;
+
+                    return result;
+                }
+
+                while (connection->input.size() < size + 2)
+                    if (!this->_fill(connection))
+                        throw mysocket::error(ECONNRESET);
+
+                result.body.append(connection->input.data(), size);
+
+                connection->input.consume(size + 2);
+            }
+        }
+
+        if (result.headers["content-length"].str().length()) {
+            std::string value = result.headers["content-length"].str();
+
+            // Digits only, and few enough that stoull() cannot throw; a repeated header folds into a list, and fails too
+            if (value.length() > 15 || !std::all_of(value.begin(), value.end(), [](const char c) {
+                return isdigit((unsigned char)c);
+            }))
+                throw http::error(UNKNOWN_ERROR, "Malformed Content-Length");
+
+            size_t length = std::stoull(value);
+
+            while (connection->input.size() < length)
+                if (!this->_fill(connection))
+                    throw mysocket::error(ECONNRESET);
+
+            result.body = std::string(connection->input.data(), length);
+
+            connection->input.consume(length);
+
+            return result;
+        }
+
+        // Delimited by the server closing the connection
+        while (this->_fill(connection))
+            continue;
+
+        result.body = connection->input.str();
+        keep_alive = false;
+
+        connection->input.clear();
+
+        return result;
+    }
+
+    std::string client::_read_line(connection* connection) {
+        size_t end;
+
+        while ((end = connection->input.view().find('\n')) == std::string_view::npos)
+            if (!this->_fill(connection))
+                throw mysocket::error(ECONNRESET);
+
+        std::string line = std::string(connection->input.data(), end);
+
+        connection->input.consume(end + 1);
+
+        if (line.length() && line.back() == '\r')
+            line.pop_back();
+
+        return line;
+    }
+
+    void client::_release(const std::string host, const int port, connection* connection) {
+        this->_mutex.lock();
+
+        std::vector<struct connection*>& idle = this->_idle[_key(host, port)];
+
+        if (idle.size() < this->_options.max_idle) {
+            idle.push_back(connection);
+
+            this->_stats.idle++;
+            this->_mutex.unlock();
+
+            return;
+        }
+
+        this->_mutex.unlock();
+        this->_discard(connection);
+    }
+
+    void client::close() {
+        this->_mutex.lock();
+
+        for (const auto& [key, idle]: this->_idle)
+            for (connection* connection: idle)
+                this->_discard(connection);
+
+        this->_mutex.unlock();
+
+        delete this;
+    }
+
+    std::vector<client::response> client::pipeline(const std::string host, const int port, std::vector<request> requests) {
+        std::string message;
+        bool        idempotent = true;
+
+        for (request& request: requests) {
+            message += _serialize(host, port, request);
+            idempotent = idempotent && _idempotent(request);
+        }
+
+        for (size_t attempt = 0; ; attempt++) {
+            bool                  keep_alive = true;
+            bool                  reused;
+            connection*           connection = this->_acquire(host, port, reused);
+            std::vector<response> responses;
+
+            try {
+                connection->socket->send(message);
+
+                for (size_t i = 0; i < requests.size(); i++) {
+                    // The server stopped keeping the connection alive; the rest went unanswered
+                    if (!keep_alive)
+                        throw mysocket::error(ECONNRESET);
+
+                    responses.push_back(this->_read(connection, tolowerstr(requests[i].method()) == "head", keep_alive));
+                }
+            } catch (mysocket::error& e) {
+                this->_discard(connection);
+
+                // A pooled connection the server closed while it sat idle; nothing was answered, so retry once on a fresh
+                // one. The requests were sent, though, and may have been acted on: only if sending them twice is safe
+                if (reused && responses.empty() && attempt == 0 && e.errnum() != ETIMEDOUT && idempotent)
+                    continue;
+
+                throw e;
+            } catch (http::error& e) {
+                this->_discard(connection);
+
+                throw e;
+            } catch (std::exception& e) {
+                // e.g. std::bad_alloc on a huge body; the connection is in an unknown state either way
+                this->_discard(connection);
+
+                throw;
+            }
+
+            this->_mutex.lock();
+            this->_stats.requests += requests.size();
+
+            if (reused)
+                this->_stats.reuses += requests.size();
+
+            this->_mutex.unlock();
+
+            if (keep_alive)
+                this->_release(host, port, connection);
+            else
+                this->_discard(connection);
+
+            return responses;
+        }
+    }
+
+    client::response client::send(const std::string host, const int port, request request) {
+        return this->pipeline(host, port, { request })[0];
+    }
+
+    struct client::statistics client::stats() {
+        this->_mutex.lock();
+
+        struct statistics result = this->_stats;
+
+        this->_mutex.unlock();
+
+        return result;
+    }
+}
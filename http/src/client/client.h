@@ -0,0 +1,105 @@
+//
+//  client.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef client_h
+#define client_h
+
+#include "http.h"
+#include "socket.h"
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace http {
+    // Keep-alive HTTP/1.1 client: reuses connections per host, and frames responses by Content-Length,
+    // chunked transfer encoding, or the server closing the connection
+    struct client {
+        // Typedef
+
+        struct options {
+            // Milliseconds; -1 for no limit
+            int    connect_timeout = -1;
+            // Idle connections kept per host
+            size_t max_idle = 8;
+            // Milliseconds to wait for each read; -1 for no limit
+            int    read_timeout = -1;
+        };
+
+        struct response {
+            std::string body;
+            // Names in lower case
+            header::map headers;
+            int         status = 0;
+            std::string status_text;
+        };
+
+        struct statistics {
+            // TCP handshakes
+            size_t connects = 0;
+            // Connections pooled right now
+            size_t idle = 0;
+            size_t requests = 0;
+            // Requests sent on a pooled connection
+            size_t reuses = 0;
+        };
+
+        // Constructors
+
+        client();
+
+        client(const struct options options);
+
+        // Member Functions
+
+        // Closes every pooled connection
+        void                  close();
+
+        // Writes the requests back to back on one connection and reads the responses in order. If a pooled connection
+        // turns out closed before any response, they are sent again on a fresh one, provided every method is idempotent
+        std::vector<response> pipeline(const std::string host, const int port, std::vector<request> requests);
+
+        response              send(const std::string host, const int port, request request);
+
+        struct statistics     stats();
+    private:
+        // Typedef
+
+        struct connection {
+            // Member Fields
+
+            mysocket::buffer      input;
+            mysocket::tcp_client* socket;
+        };
+
+        // Constructors
+
+        ~client();
+
+        // Member Fields
+
+        std::map<std::string, std::vector<connection*>> _idle;
+        std::mutex                                     _mutex;
+        struct options                                 _options;
+        struct statistics                              _stats;
+
+        // Member Functions
+
+        connection*           _acquire(const std::string host, const int port, bool& reused);
+
+        void                  _discard(connection* connection);
+
+        bool                  _fill(connection* connection);
+
+        response              _read(connection* connection, const bool head, bool& keep_alive);
+
+        std::string           _read_line(connection* connection);
+
+        void                  _release(const std::string host, const int port, connection* connection);
+    };
+}
+
+#endif /* client_h */
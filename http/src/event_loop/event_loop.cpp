@@ -0,0 +1,297 @@
+//
+//  event_loop.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "event_loop.h"
+#include "logger.h"
+#include "socket.h"
+
+namespace mysocket {
+    // Non-Member Fields
+
+    const int MAX_EVENTS = 256;
+
+    // Non-Member Functions
+
+    void set_nonblocking(const int file_descriptor) {
+        int flags = fcntl(file_descriptor, F_GETFL, 0);
+
+        if (flags == -1 || fcntl(file_descriptor, F_SETFL, flags | O_NONBLOCK) == -1)
+            throw mysocket::error(errno);
+    }
+
+    // Constructors
+
+    event_loop::event_loop(const bool uring) {
+#ifdef __linux__
+        this->_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+#else
+        this->_file_descriptor = kqueue();
+#endif
+
+        if (this->_file_descriptor == -1)
+            throw mysocket::error(errno);
+
+#ifdef __linux__
+        this->_wakeup_file_descriptors[0] = this->_wakeup_file_descriptors[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (this->_wakeup_file_descriptors[0] == -1) {
+#else
+        if (pipe(this->_wakeup_file_descriptors) == -1) {
+#endif
+            ::close(this->_file_descriptor);
+
+            throw mysocket::error(errno);
+        }
+
+        set_nonblocking(this->_wakeup_file_descriptors[0]);
+        set_nonblocking(this->_wakeup_file_descriptors[1]);
+
+        this->_wakeup = watcher(this->_wakeup_file_descriptors[0], [this](const int) {
+            char buff[64];
+
+            // Drain
+            while (read(this->_wakeup_file_descriptors[0], buff, sizeof(buff)) > 0)
+                continue;
+        });
+
+        this->add(&this->_wakeup, READABLE);
+
+#ifdef __linux__
+        if (!uring)
+            return;
+
+        this->_ring = new struct uring(1024);
+
+        // Readiness watchers stay on epoll; the ring waits on the epoll descriptor itself
+        this->_epoll_operation = operation([this](const int, const unsigned) {
+            this->_poll(0);
+            this->_ring->prep_poll(this->_file_descriptor, POLLIN, &this->_epoll_operation);
+        });
+#endif
+    }
+
+    event_loop::operation::operation() { }
+
+    event_loop::operation::operation(const std::function<void(const int, const unsigned)> callback) {
+        this->callback = callback;
+    }
+
+    event_loop::watcher::watcher() { }
+
+    event_loop::watcher::watcher(const int file_descriptor, const std::function<void(const int)> callback) {
+        this->file_descriptor = file_descriptor;
+        this->callback = callback;
+    }
+
+    event_loop::~event_loop() { }
+
+    // Member Functions
+
+    void event_loop::_control(watcher* watcher, const int events, const bool add) {
+#ifdef __linux__
+        struct epoll_event event;
+
+        event.events = EPOLLET | EPOLLRDHUP;
+        event.data.ptr = watcher;
+
+        if (events & READABLE)
+            event.events |= EPOLLIN;
+
+        if (events & WRITABLE)
+            event.events |= EPOLLOUT;
+
+        if (epoll_ctl(this->_file_descriptor, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, watcher->file_descriptor, &event))
+            throw mysocket::error(errno);
+#else
+        struct kevent changes[2];
+
+        EV_SET(&changes[0], watcher->file_descriptor, EVFILT_READ, events & READABLE ? EV_ADD | EV_CLEAR : EV_DELETE, 0, 0, watcher);
+        EV_SET(&changes[1], watcher->file_descriptor, EVFILT_WRITE, events & WRITABLE ? EV_ADD | EV_CLEAR : EV_DELETE, 0, 0, watcher);
+
+        for (size_t i = 0; i < 2; i++) {
+            // Deleting a filter that was never added fails with ENOENT; ignore it
+            if (kevent(this->_file_descriptor, &changes[i], 1, NULL, 0, NULL) == -1 && !(changes[i].flags & EV_DELETE))
+                throw mysocket::error(errno);
+        }
+#endif
+    }
+
+    void event_loop::_poll(const int timeout) {
+#ifdef __linux__
+        struct epoll_event events[MAX_EVENTS];
+
+        int nevents = epoll_wait(this->_file_descriptor, events, MAX_EVENTS, timeout);
+#else
+        struct kevent   events[MAX_EVENTS];
+        struct timespec ts = { timeout / 1000, (timeout % 1000) * 1000000 };
+
+        int nevents = kevent(this->_file_descriptor, NULL, 0, events, MAX_EVENTS, timeout < 0 ? NULL : &ts);
+#endif
+
+        if (nevents == -1) {
+            if (errno == EINTR)
+                return;
+
+            throw mysocket::error(errno);
+        }
+
+        for (int i = 0; i < nevents; i++) {
+#ifdef __linux__
+            watcher* watcher = (struct watcher *)events[i].data.ptr;
+            int      flags = 0;
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+                flags |= READABLE;
+
+            if (events[i].events & EPOLLOUT)
+                flags |= WRITABLE;
+
+            if (events[i].events & EPOLLERR)
+                flags |= ERROR | READABLE;
+#else
+            watcher* watcher = (struct watcher *)events[i].udata;
+            int      flags = events[i].filter == EVFILT_WRITE ? WRITABLE : READABLE;
+
+            if (events[i].flags & EV_ERROR)
+                flags |= ERROR;
+#endif
+
+            try {
+                watcher->callback(flags);
+            } catch (std::exception& e) {
+                logger::error(e.what());
+            }
+        }
+    }
+
+    void event_loop::_run_tasks() {
+        this->_mutex.lock();
+
+        std::vector<std::function<void()>> tasks;
+
+        tasks.swap(this->_tasks);
+
+        this->_mutex.unlock();
+
+        for (const auto& task: tasks) {
+            try {
+                task();
+            } catch (std::exception& e) {
+                logger::error(e.what());
+            }
+        }
+    }
+
+    void event_loop::_wake() {
+        uint64_t value = 1;
+
+        // Non-blocking; a full counter or pipe already guarantees a wakeup
+        if (write(this->_wakeup_file_descriptors[1], &value, sizeof(value)) == -1)
+            return;
+    }
+
+    void event_loop::add(watcher* watcher, const int events) {
+        this->_control(watcher, events, true);
+    }
+
+    void event_loop::close() {
+        // Release anything still queued, e.g. deferred deletes
+        this->_run_tasks();
+
+#ifdef __linux__
+        if (this->_ring)
+            this->_ring->close();
+#endif
+
+        ::close(this->_file_descriptor);
+        ::close(this->_wakeup_file_descriptors[0]);
+
+        if (this->_wakeup_file_descriptors[1] != this->_wakeup_file_descriptors[0])
+            ::close(this->_wakeup_file_descriptors[1]);
+
+        delete this;
+    }
+
+    bool event_loop::is_current() const {
+        return this->_thread_id.load() == std::this_thread::get_id();
+    }
+
+    void event_loop::modify(watcher* watcher, const int events) {
+        this->_control(watcher, events, false);
+    }
+
+    void event_loop::post(const std::function<void()> task) {
+        this->_mutex.lock();
+        this->_tasks.push_back(task);
+        this->_mutex.unlock();
+
+        // Tasks posted from the loop itself run at the end of the current iteration
+        if (!this->is_current())
+            this->_wake();
+    }
+
+    void event_loop::remove(watcher* watcher) {
+#ifdef __linux__
+        epoll_ctl(this->_file_descriptor, EPOLL_CTL_DEL, watcher->file_descriptor, NULL);
+#else
+        this->_control(watcher, 0, false);
+#endif
+    }
+
+#ifdef __linux__
+    uring* event_loop::ring() const {
+        return this->_ring;
+    }
+#endif
+
+    void event_loop::run() {
+        this->_thread_id.store(std::this_thread::get_id());
+
+#ifdef __linux__
+        if (this->_ring) {
+            this->_ring->prep_poll(this->_file_descriptor, POLLIN, &this->_epoll_operation);
+
+            while (this->_running.load()) {
+                // One system call submits everything queued since the last wait and reaps completions
+                this->_ring->submit(true, this->_timers.next_timeout());
+                this->_ring->completions([](const struct io_uring_cqe* cqe) {
+                    operation* operation = (struct operation *)cqe->user_data;
+
+                    if (operation == NULL)
+                        return;
+
+                    try {
+                        operation->callback(cqe->res, cqe->flags);
+                    } catch (std::exception& e) {
+                        logger::error(e.what());
+                    }
+                });
+
+                this->_timers.advance();
+                this->_run_tasks();
+            }
+
+            return;
+        }
+#endif
+
+        while (this->_running.load()) {
+            this->_poll(this->_timers.next_timeout());
+            this->_timers.advance();
+            this->_run_tasks();
+        }
+    }
+
+    void event_loop::stop() {
+        this->_running.store(false);
+        this->_wake();
+    }
+
+    timer_wheel& event_loop::timers() {
+        return this->_timers;
+    }
+}
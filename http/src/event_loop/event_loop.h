@@ -0,0 +1,134 @@
+//
+//  event_loop.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef event_loop_h
+#define event_loop_h
+
+#include "timer_wheel.h"
+#include "uring.h"
+#include "util.h"
+#include <atomic>
+#include <fcntl.h>          // fcntl
+#include <functional>
+#include <mutex>
+#include <poll.h>           // POLLIN
+#include <thread>
+#include <unistd.h>         // close, pipe, read, write
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>      // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/eventfd.h>    // eventfd
+#else
+#include <sys/event.h>      // kevent, kqueue
+#endif
+
+namespace mysocket {
+    // Non-Member Functions
+
+    void set_nonblocking(const int file_descriptor);
+
+    // Edge-triggered readiness loop (epoll on Linux, kqueue elsewhere), optionally driven by io_uring completions
+    struct event_loop {
+        // Typedef
+
+        enum event {
+            READABLE = 1,
+            WRITABLE = 2,
+            ERROR = 4
+        };
+
+        struct operation {
+            // Constructors
+
+            operation();
+
+            operation(const std::function<void(const int, const unsigned)> callback);
+
+            // Member Fields
+
+            // Receives the completion's result and flags
+            std::function<void(const int, const unsigned)> callback;
+        };
+
+        struct watcher {
+            // Constructors
+
+            watcher();
+
+            watcher(const int file_descriptor, const std::function<void(const int)> callback);
+
+            // Member Fields
+
+            std::function<void(const int)> callback;
+            int                            file_descriptor = -1;
+        };
+
+        // Constructors
+
+        event_loop(const bool uring = false);
+
+        // Member Functions
+
+        void add(watcher* watcher, const int events);
+
+        void close();
+
+        bool is_current() const;
+
+        void modify(watcher* watcher, const int events);
+
+        void post(const std::function<void()> task);
+
+        void remove(watcher* watcher);
+
+#ifdef __linux__
+        // NULL unless the loop waits on io_uring
+        uring* ring() const;
+#endif
+
+        void run();
+
+        void stop();
+
+        // Deadlines run on the loop thread between batches of events; only touch it from there
+        timer_wheel& timers();
+    private:
+        // Constructors
+
+        ~event_loop();
+
+        // Member Fields
+
+#ifdef __linux__
+        operation                          _epoll_operation;
+#endif
+        int                                _file_descriptor;
+        std::mutex                         _mutex;
+#ifdef __linux__
+        uring*                             _ring = NULL;
+#endif
+        std::atomic<bool>                  _running = true;
+        std::vector<std::function<void()>> _tasks;
+        std::atomic<std::thread::id>       _thread_id;
+        timer_wheel                        _timers;
+        watcher                            _wakeup;
+        int                                _wakeup_file_descriptors[2] = { -1, -1 };
+
+        // Member Functions
+
+        void _control(watcher* watcher, const int events, const bool add);
+
+        void _poll(const int timeout);
+
+        void _run_tasks();
+
+        void _wake();
+    };
+}
+
+#endif /* event_loop_h */
@@ -30,8 +30,16 @@ namespace http {
                 return "Unauthorized";
             case NOT_FOUND:
                 return "Not Found";
+            case PAYLOAD_TOO_LARGE:
+                return "Payload Too Large";
+            case REQUEST_HEADER_FIELDS_TOO_LARGE:
+                return "Request Header Fields Too Large";
             case INTERNAL_SERVER_ERROR:
                 return "Internal Server Error";
+            case NOT_IMPLEMENTED:
+                return "Not Implemented";
+            case SERVICE_UNAVAILABLE:
+                return "Service Unavailable";
             default:
                 break;
         }
@@ -39,64 +47,62 @@ namespace http {
         return "";
     }
 
-    std::string http_version() {
-        return "HTTP/1.1";
+    bool _iequals(const std::string_view a, const std::string_view b) {
+        return a.length() == b.length() && std::equal(a.begin(), a.end(), b.begin(), [](const char a, const char b) {
+            return tolower((unsigned char)a) == tolower((unsigned char)b);
+        });
     }
 
-    size_t timeout() {
-        return 30;
+    // RFC 9110 token: a method or a field name
+    bool _is_token(const std::string_view text) {
+        return !text.empty() && std::all_of(text.begin(), text.end(), [](const char c) {
+            return isalnum((unsigned char)c) || (c && strchr("!#$%&'*+-.^_`|~", c) != NULL);
+        });
     }
 
-    request parse_request(const std::string message) {
-        std::istringstream iss(message);
-        std::string        str;
+    // Space or tab
+    std::string_view _trim(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+            text.remove_prefix(1);
 
-        getline(iss, str);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+            text.remove_suffix(1);
 
-        std::vector<std::string> tokens = ::tokens(str);
-
-        if (!(tokens.size() == 3 && tokens[2] == http_version()))
-            throw http::error(BAD_REQUEST);
-
-        std::string method = tolowerstr(tokens[0]),
-                     target = tokens[1];
-        header::map headers;
-
-        while (getline(iss, str)) {
-            std::vector<std::string> header = split(str, ":");
+        return text;
+    }
 
-            if (header.size() == 1)
-                break;
+    std::string http_version() {
+        return "HTTP/1.1";
+    }
 
-            headers[tolowerstr(header[0])] = trim(str.substr(header[0].length() + 1));
-        }
+    size_t timeout() {
+        return 30;
+    }
 
-        int         content_length = headers["content-length"];
-        std::string body = "";
+    request parse_request(const std::string_view text) {
+        // Framed and held to the connection's limits already
+        parser parser({ .max_body = SIZE_MAX, .max_head = SIZE_MAX, .max_headers = SIZE_MAX });
 
-        if (content_length != INT_MIN) {
-            std::vector<std::string> value;
+        if (parser.parse(text) != parser::COMPLETE)
+            throw http::error(parser.status() == OK ? BAD_REQUEST : parser.status());
 
-            while (getline(iss, str))
-                value.push_back(trim_end(str));
+        return request(parser);
+    }
 
-            body = join(value, "\r\n");
-            body = body.substr(0, std::min((int) body.length(), content_length));
-        }
+    std::string redirect(header::map& headers, const status_code status, const std::string location) {
+        return join(redirect_buffers(headers, status, location), "");
+    }
 
-        return request(method, target, headers, body);
+    std::string redirect(header::map& headers, const std::string location) {
+        return redirect(headers, FOUND, location);
     }
 
-    std::string redirect(header::map& headers, const status_code status, const std::string location) {
+    std::vector<std::string> redirect_buffers(header::map& headers, const status_code status, const std::string location) {
         headers["Location"] = location;
 
         std::string status_text = strstatus(status);
 
-        return response(status, status_text, status_text + ". Redirecting to " + location, headers);
-    }
-
-    std::string redirect(header::map& headers, const std::string location) {
-        return redirect(headers, FOUND, location);
+        return response_buffers(status, status_text, status_text + ". Redirecting to " + location, headers);
     }
 
     std::string response(const std::string text, header::map headers) {
@@ -104,12 +110,20 @@ namespace http {
     }
 
     std::string response(const status_code status, const std::string status_text, const std::string text, header::map headers, const bool date) {
+        return join(response_buffers(status, status_text, text, headers, date), "");
+    }
+
+    std::vector<std::string> response_buffers(const status_code status, const std::string status_text, const std::string text, header::map headers, const bool date) {
         std::ostringstream oss(http_version() + " ");
 
         oss.seekp(0, std::ios::end);
 
         oss << std::to_string(status) << " " << status_text << "\r\n";
 
+        std::string status_line = oss.str();
+
+        oss.str("");
+
         // Response headers
         if (date) {
             time_t now = time(0);
@@ -126,27 +140,19 @@ namespace http {
                          time = tokens[3],
                          year = tokens[4];
 
-            oss << day << ", " << date << " " << month << " " << year << " " << time << " GMT";
+            oss << day << ", " << date << " " << month << " " << year << " " << time << " GMT" << "\r\n";
         }
 
-        for (const auto& [key, value]: headers) {
-            oss << "\r\n";
-            oss << key << ": " << value.str();
-        }
+        for (const auto& [key, value]: headers)
+            oss << key << ": " << value.str() << "\r\n";
         
-        if (text.length()) {
-            if (headers["Transfer-Encoding"].str().empty()) {
-                headers.erase("Transfer-Encoding");
-                
-                oss << "\r\n";
-                oss << "Content-Length: " << text.length();
-            }
+        if (text.length() && headers["Transfer-Encoding"].str().empty())
+            oss << "Content-Length: " << text.length() << "\r\n";
 
-            oss << "\r\n\r\n";
-            oss << text;
-        }
+        // The blank line ends the head, with or without a body
+        oss << "\r\n";
         
-        return oss.str();
+        return { status_line, oss.str(), text };
     }
 
     // Constructors
@@ -183,6 +189,17 @@ namespace http {
         this->_set(value);
     }
 
+    parser::parser() { }
+
+    parser::parser(const struct limits limits) {
+        this->_limits = limits;
+    }
+
+    request::request(const parser& parser): request(tolowerstr(std::string(parser.method())), std::string(parser.target()), { }, std::string(parser.body())) {
+        for (const auto& [name, value]: parser.headers())
+            this->_headers[tolowerstr(std::string(name))] = std::string(value);
+    }
+
     request::request(const std::string method, const std::string url, header::map headers, const std::string body) {
         this->_method = method;
 
@@ -288,10 +305,119 @@ namespace http {
         return this->list();
     }
 
+    parser::result parser::_fail(const status_code status) {
+        this->_state = FAILED;
+        this->_status = status;
+
+        return INVALID;
+    }
+
+    status_code parser::_header(const std::string_view line) {
+        // Obsolete line folding
+        if (line.front() == ' ' || line.front() == '\t')
+            return BAD_REQUEST;
+
+        size_t colon = line.find(':');
+
+        // No whitespace between name and colon, so each hop reads the same name
+        if (colon == std::string_view::npos || !_is_token(line.substr(0, colon)))
+            return BAD_REQUEST;
+
+        std::string_view name = line.substr(0, colon),
+                         value = _trim(line.substr(colon + 1));
+
+        if (std::any_of(value.begin(), value.end(), [](const char c) {
+            return ((unsigned char)c < ' ' && c != '\t') || c == 0x7f;
+        }))
+            return BAD_REQUEST;
+
+        if (this->_headers.size() >= this->_limits.max_headers)
+            return REQUEST_HEADER_FIELDS_TOO_LARGE;
+
+        if (_iequals(name, "content-length")) {
+            // Digits only; bounded so the length cannot overflow
+            if (value.empty() || value.length() > 15 || !std::all_of(value.begin(), value.end(), [](const char c) {
+                return isdigit((unsigned char)c);
+            }))
+                return BAD_REQUEST;
+
+            size_t content_length = std::stoull(std::string(value));
+
+            // Repeated, it must agree, or two readers could frame the body differently
+            if (this->_has_content_length && content_length != this->_content_length)
+                return BAD_REQUEST;
+
+            this->_content_length = content_length;
+            this->_has_content_length = true;
+        }
+
+        // No transfer coding is supported (RFC 9112, section 6.1); refused rather than misread as the next request
+        if (_iequals(name, "transfer-encoding"))
+            return NOT_IMPLEMENTED;
+
+        this->_headers.push_back({ name, value });
+
+        return OK;
+    }
+
+    void parser::_rebase(const std::string_view text) {
+        if (this->_base == text.data())
+            return;
+
+        auto move = [this, text](std::string_view& view) {
+            if (view.data() != NULL)
+                view = std::string_view(text.data() + (view.data() - this->_base), view.length());
+        };
+
+        move(this->_method);
+        move(this->_target);
+        move(this->_version);
+        move(this->_body);
+
+        for (field& field: this->_headers) {
+            move(field.name);
+            move(field.value);
+        }
+
+        this->_base = text.data();
+    }
+
+    bool parser::_request_line(const std::string_view line) {
+        size_t first = line.find(' '),
+               second = first == std::string_view::npos ? first : line.find(' ', first + 1);
+
+        if (second == std::string_view::npos)
+            return false;
+
+        this->_method = line.substr(0, first);
+        this->_target = line.substr(first + 1, second - first - 1);
+        this->_version = line.substr(second + 1);
+
+        return _is_token(this->_method) && !this->_target.empty() && std::all_of(this->_target.begin(), this->_target.end(), [](const char c) {
+            return (unsigned char)c > ' ' && c != 0x7f;
+        }) && this->_version == http_version();
+    }
+
+    std::string_view parser::body() const {
+        return this->_body;
+    }
+
     std::string request::body() const {
         return this->_body;
     }
 
+    std::string_view parser::header(const std::string_view name) const {
+        for (const field& field: this->_headers)
+            if (_iequals(field.name, name))
+                return field.value;
+
+        return std::string_view();
+    }
+
+    const std::vector<parser::field>& parser::headers() const {
+        return this->_headers;
+    }
+
     header::map request::headers() {
         return this->_headers;
     }
@@ -304,14 +430,115 @@ namespace http {
         return this->_list;
     }
 
+    size_t parser::length() const {
+        return this->_position;
+    }
+
+    std::string_view parser::method() const {
+        return this->_method;
+    }
+
     std::string request::method() const {
         return this->_method;
     }
 
+    parser::result parser::parse(const std::string_view text) {
+        this->_rebase(text);
+
+        if (this->_state == DONE)
+            return COMPLETE;
+
+        if (this->_state == FAILED)
+            return INVALID;
+
+        while (this->_state != BODY) {
+            size_t stop = text.find('\n', std::max(this->_position, this->_scanned));
+
+            if (stop == std::string_view::npos) {
+                // Everything so far is head, and already too much of it
+                if (text.length() > this->_limits.max_head)
+                    return this->_fail(REQUEST_HEADER_FIELDS_TOO_LARGE);
+
+                this->_scanned = text.length();
+
+                return INCOMPLETE;
+            }
+
+            if (stop >= this->_limits.max_head)
+                return this->_fail(REQUEST_HEADER_FIELDS_TOO_LARGE);
+
+            std::string_view line = text.substr(this->_position, stop - this->_position);
+
+            // CRLF, or a bare LF
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+
+            this->_position = stop + 1;
+
+            if (this->_state == REQUEST_LINE) {
+                // Blank lines ahead of a request, e.g. after a body's stray CRLF, are skipped
+                if (line.empty())
+                    continue;
+
+                if (!this->_request_line(line))
+                    return this->_fail(BAD_REQUEST);
+
+                this->_state = HEADERS;
+
+                continue;
+            }
+
+            if (line.empty()) {
+                // Refused before any of it arrives
+                if (this->_content_length > this->_limits.max_body)
+                    return this->_fail(PAYLOAD_TOO_LARGE);
+
+                this->_state = BODY;
+
+                break;
+            }
+
+            status_code status = this->_header(line);
+
+            if (status != OK)
+                return this->_fail(status);
+        }
+
+        if (text.length() - this->_position < this->_content_length)
+            return INCOMPLETE;
+
+        this->_body = text.substr(this->_position, this->_content_length);
+        this->_position += this->_content_length;
+        this->_state = DONE;
+
+        return COMPLETE;
+    }
+
     url::param::map request::params() {
         return this->_params;
     }
 
+    void parser::reset() {
+        this->_base = NULL;
+        this->_body = std::string_view();
+        this->_content_length = 0;
+        this->_has_content_length = false;
+        this->_method = std::string_view();
+        this->_position = 0;
+        this->_scanned = 0;
+        this->_state = REQUEST_LINE;
+        this->_status = OK;
+        this->_target = std::string_view();
+        this->_version = std::string_view();
+
+        // Keeps its capacity
+        this->_headers.clear();
+    }
+
+    status_code parser::status() const {
+        return this->_status;
+    }
+
     status_code error::status() const {
         return this->_status;
     }
@@ -328,6 +555,14 @@ namespace http {
         return this->_text;
     }
 
+    std::string_view parser::target() const {
+        return this->_target;
+    }
+
+    std::string_view parser::version() const {
+        return this->_version;
+    }
+
     std::string request::url() const {
         return this->_url;
     }
@@ -13,6 +13,8 @@
 #include "util.h"
 #include <cmath>
 #include <set>
+#include <string_view>
+#include <vector>
 
 namespace http {
     // Typedef
@@ -27,7 +29,11 @@ namespace http {
         BAD_REQUEST = 400,
         UNAUTHORIZED = 401,
         NOT_FOUND = 404,
+        PAYLOAD_TOO_LARGE = 413,
+        REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
         INTERNAL_SERVER_ERROR = 500,
+        NOT_IMPLEMENTED = 501,
+        SERVICE_UNAVAILABLE = 503,
     };
 
 
@@ -125,9 +131,105 @@ namespace http {
         std::set<std::string> _set(std::set<std::string> value);
     };
 
+    // Incremental HTTP/1.1 request parser. Given the bytes buffered so far from the start of a message, each call
+    // resumes where the last one stopped, so a request split over any number of reads is scanned once. Method, target,
+    // headers and body are views into those bytes, valid until they change; nothing is copied or allocated, beyond
+    // the header list's first growth, which reset() keeps
+    struct parser {
+        // Typedef
+
+        struct field {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        struct limits {
+            // Content-Length, in bytes; over it, 413
+            size_t max_body = 1 << 20;
+            // Request line and headers, in bytes; over it, 431
+            size_t max_head = 8192;
+            // Header fields; over it, 431
+            size_t max_headers = 100;
+        };
+
+        enum result { INCOMPLETE, COMPLETE, INVALID };
+
+        // Constructors
+
+        parser();
+
+        parser(const struct limits limits);
+
+        // Member Functions
+
+        std::string_view          body() const;
+
+        // First field named name, ignoring case; empty if there is none
+        std::string_view          header(const std::string_view name) const;
+
+        const std::vector<field>& headers() const;
+
+        // Bytes of the complete message, body included; what to consume before the next one
+        size_t                    length() const;
+
+        std::string_view          method() const;
+
+        // INCOMPLETE until the head and Content-Length bytes of body have arrived; COMPLETE and INVALID stick until
+        // reset(). Pass the same message each time, with whatever has arrived since appended; passed a copy of it, e.g.
+        // one kept past the buffer it arrived in, the views move onto the copy without scanning it again
+        result                    parse(const std::string_view text);
+
+        // For the next message
+        void                      reset();
+
+        // Why the message is INVALID: BAD_REQUEST, PAYLOAD_TOO_LARGE, REQUEST_HEADER_FIELDS_TOO_LARGE or
+        // NOT_IMPLEMENTED
+        status_code               status() const;
+
+        std::string_view          target() const;
+
+        std::string_view          version() const;
+    private:
+        // Typedef
+
+        enum state { REQUEST_LINE, HEADERS, BODY, DONE, FAILED };
+
+        // Member Fields
+
+        // Where the views point; moved along with the text if it is reallocated between calls
+        const char*               _base = NULL;
+        std::string_view          _body;
+        size_t                    _content_length = 0;
+        bool                      _has_content_length = false;
+        std::vector<field>        _headers;
+        struct limits             _limits;
+        std::string_view          _method;
+        // Start of the next line
+        size_t                    _position = 0;
+        // Searched already, without finding the end of a line
+        size_t                    _scanned = 0;
+        state                     _state = REQUEST_LINE;
+        status_code               _status = OK;
+        std::string_view          _target;
+        std::string_view          _version;
+
+        // Member Functions
+
+        result                    _fail(const status_code status);
+
+        status_code               _header(const std::string_view line);
+
+        void                      _rebase(const std::string_view text);
+
+        bool                      _request_line(const std::string_view line);
+    };
+
     struct request {
         // Constructors
 
+        // From a COMPLETE parser; method and header names in lower case
+        request(const parser& parser);
+
         request(const std::string method, const std::string url, header::map headers = {}, const std::string body = "");
 
         // Member Functions
@@ -155,16 +257,23 @@ namespace http {
 
     std::string http_version();
 
-    request     parse_request(const std::string text);
+    // text holds one complete request; throws http::error otherwise
+    request     parse_request(const std::string_view text);
 
     std::string redirect(header::map& headers, const std::string location);
 
     std::string redirect(header::map& headers, const status_code status, const std::string location);
 
+    // See response_buffers()
+    std::vector<std::string> redirect_buffers(header::map& headers, const status_code status, const std::string location);
+
     std::string response(const std::string text, header::map headers);
 
     std::string response(const status_code status, const std::string status_text, const std::string text, header::map headers, const bool date = true);
 
+    // Status line, header block and body, for a gathered send that never joins them
+    std::vector<std::string> response_buffers(const status_code status, const std::string status_text, const std::string text, header::map headers, const bool date = true);
+
     std::string strstatus(const status_code status);
 
     size_t      timeout();
@@ -0,0 +1,165 @@
+//
+//  loopback.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "loopback.h"
+#include "event_loop.h"
+
+namespace mysocket {
+    // Constructors
+
+    loopback::loopback(const std::shared_ptr<channel> channel, const int side) {
+        this->_channel = channel;
+        this->_side = side;
+    }
+
+    loopback::~loopback() {
+        this->on_ready(nullptr);
+        this->close();
+    }
+
+    loopback::channel::channel(const size_t capacity): rings { ring(capacity), ring(capacity) } { }
+
+    loopback::ring::ring(const size_t capacity) {
+        size_t size = 1;
+
+        while (size < capacity)
+            size <<= 1;
+
+        this->data = std::make_unique<char[]>(size);
+        this->mask = size - 1;
+    }
+
+    // Member Functions
+
+    void loopback::_notify(const int side, const int events) {
+        std::lock_guard<std::mutex> lock(this->_channel->mutexes[side]);
+
+        if (this->_channel->callbacks[side])
+            this->_channel->callbacks[side](events);
+    }
+
+    void loopback::close() {
+        if (this->_channel->rings[this->_side].closed.exchange(true))
+            return;
+
+        // Wakes the peer whichever way it waits: reads then end, and sends fail
+        this->_notify(1 - this->_side, event_loop::READABLE | event_loop::WRITABLE);
+    }
+
+    void loopback::on_ready(const std::function<void(const int events)> callback) {
+        std::lock_guard<std::mutex> lock(this->_channel->mutexes[this->_side]);
+
+        this->_channel->callbacks[this->_side] = callback;
+    }
+
+    std::pair<std::shared_ptr<loopback>, std::shared_ptr<loopback>> loopback::pair(const size_t capacity) {
+        std::shared_ptr<channel> channel = std::make_shared<struct channel>(capacity);
+
+        return {
+            std::shared_ptr<loopback>(new loopback(channel, 0)),
+            std::shared_ptr<loopback>(new loopback(channel, 1))
+        };
+    }
+
+    size_t loopback::ring::read(char* data, const size_t len) {
+        size_t head = this->head.load(),
+               available = std::min(len, this->tail.load() - head),
+               offset = head & this->mask,
+               first = std::min(available, this->mask + 1 - offset);
+
+        memcpy(data, this->data.get() + offset, first);
+        memcpy(data + first, this->data.get(), available - first);
+
+        this->head.store(head + available);
+
+        return available;
+    }
+
+    ssize_t loopback::recv(char* data, const size_t len) {
+        ring&  input = this->_channel->rings[1 - this->_side];
+        size_t received = input.read(data, len);
+
+        if (received == 0) {
+            // Announced before looking again, so a send racing this one either sees the flag or is seen
+            input.reader_waiting.store(true);
+
+            // Read before the last look, so nothing sent ahead of the close is missed
+            bool closed = input.closed.load();
+
+            if ((received = input.read(data, len)) == 0) {
+                if (closed)
+                    return 0;
+
+                errno = EAGAIN;
+
+                return -1;
+            }
+        }
+
+        if (input.writer_waiting.exchange(false))
+            this->_notify(1 - this->_side, event_loop::WRITABLE);
+
+        return received;
+    }
+
+    ssize_t loopback::send(const struct iovec* iov, const size_t count) {
+        ring& output = this->_channel->rings[this->_side];
+
+        if (output.closed.load() || this->_channel->rings[1 - this->_side].closed.load()) {
+            errno = EPIPE;
+
+            return -1;
+        }
+
+        auto write = [&output, iov, count]() {
+            size_t sent = 0;
+
+            for (size_t i = 0; i < count; i++) {
+                size_t len = output.write((const char *)iov[i].iov_base, iov[i].iov_len);
+
+                sent += len;
+
+                if (len < iov[i].iov_len)
+                    break;
+            }
+
+            return sent;
+        };
+
+        size_t sent = write();
+
+        if (sent == 0 && count) {
+            // As in recv(): announced, then looked at again
+            output.writer_waiting.store(true);
+
+            if ((sent = write()) == 0) {
+                errno = EAGAIN;
+
+                return -1;
+            }
+        }
+
+        if (output.reader_waiting.exchange(false))
+            this->_notify(1 - this->_side, event_loop::READABLE);
+
+        return sent;
+    }
+
+    size_t loopback::ring::write(const char* data, const size_t len) {
+        size_t tail = this->tail.load(),
+               available = std::min(len, this->mask + 1 - (tail - this->head.load())),
+               offset = tail & this->mask,
+               first = std::min(available, this->mask + 1 - offset);
+
+        memcpy(this->data.get() + offset, data, first);
+        memcpy(this->data.get(), data + first, available - first);
+
+        this->tail.store(tail + available);
+
+        return available;
+    }
+}
@@ -0,0 +1,101 @@
+//
+//  loopback.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef loopback_h
+#define loopback_h
+
+#include "transport.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>      // memcpy
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace mysocket {
+    // In-process stand-in for a connected socket pair: each way is a lock-free ring buffer, with no descriptor and no
+    // system call, so a server and everything above it can be driven, and measured, without the kernel. Each end
+    // belongs to one thread at a time
+    struct loopback: public transport {
+        // Constructors
+
+        ~loopback();
+
+        // Member Functions
+
+        // Two connected ends, each buffering up to capacity bytes (rounded up to a power of two) on their way to the other
+        static std::pair<std::shared_ptr<loopback>, std::shared_ptr<loopback>> pair(const size_t capacity = 1 << 16);
+
+        void    close();
+
+        void    on_ready(const std::function<void(const int events)> callback);
+
+        ssize_t recv(char* data, const size_t len);
+
+        ssize_t send(const struct iovec* iov, const size_t count);
+    private:
+        // Typedef
+
+        // Single producer, single consumer. Positions only grow, and are masked into the buffer
+        struct ring {
+            // Constructors
+
+            ring(const size_t capacity);
+
+            // Member Fields
+
+            // Set by the writing end once it has closed
+            std::atomic<bool>       closed = false;
+            std::unique_ptr<char[]> data;
+            // Kept apart from tail, so the two ends do not share a cache line
+            alignas(64)
+            std::atomic<size_t>     head = 0;
+            // The reader found it empty, and waits for on_ready()
+            std::atomic<bool>       reader_waiting = false;
+            alignas(64)
+            std::atomic<size_t>     tail = 0;
+            // The writer found it full
+            std::atomic<bool>       writer_waiting = false;
+            size_t                  mask;
+
+            // Member Functions
+
+            size_t read(char* data, const size_t len);
+
+            size_t write(const char* data, const size_t len);
+        };
+
+        // Shared by both ends; ring i carries what end i sends
+        struct channel {
+            // Constructors
+
+            channel(const size_t capacity);
+
+            // Member Fields
+
+            std::function<void(const int events)> callbacks[2];
+            // Held while a callback runs, so on_ready() can wait it out
+            std::mutex                            mutexes[2];
+            ring                                  rings[2];
+        };
+
+        // Constructors
+
+        loopback(const std::shared_ptr<channel> channel, const int side);
+
+        // Member Fields
+
+        std::shared_ptr<channel> _channel;
+        int                      _side;
+
+        // Member Functions
+
+        void    _notify(const int side, const int events);
+    };
+}
+
+#endif /* loopback_h */
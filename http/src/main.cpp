@@ -5,34 +5,108 @@
 //  Created by Corey Ferguson on 9/24/25.
 //
 
+#include "basic_tcp_server.h"
 #include "http.h"
 #include "logger.h"
+#include "loopback.h"
 #include "service.h"
 #include "socket.h"
+#include "supervisor.h"
 #include "url.h"
+#include "worker_pool.h"
+#include <memory>
+#include <sys/stat.h>
 
 using namespace http;
 using namespace mysocket;
 using namespace std;
 
+// Typedef
+
+// A request framed on the event loop, copied off the connection for a worker, with the parser that framed it
+struct message {
+    parser parser;
+    string text;
+};
+
+// Requests framed on a connection's event loop, answered in order by one worker at a time
+struct session {
+    bool                  busy = false;
+    // Number of requests received
+    size_t                nrequests = 0;
+    mutex                 mutex;
+    // Frames requests on the event loop, resuming across reads
+    parser                parser;
+    deque<struct message> requests;
+};
+
+// Called by the server directly rather than through std::function, so the request path inlines into its dispatch
+struct http_handler {
+    // Member Functions
+
+    void operator()(tcp_server::connection* connection) const;
+
+    void on_readable(tcp_server::connection* connection) const;
+};
+
+// Fixed at compile time; the rest of server_options() is read at startup
+struct http_policy: public default_policy {
+    // Member Fields
+
+    static constexpr tcp_server::io_mode mode = tcp_server::IO_URING;
+    // Answer requests on the core that read them, one event loop per CPU, rather than hand them to workers
+    static constexpr bool                thread_per_core = false;
+};
+
+typedef basic_tcp_server<http_handler, http_policy> http_server;
+
 // Non-Member Fields
 
-header::map  _headers = {
+// This worker's, when preforked
+supervisor::counters* _counters = NULL;
+// Set on shutdown; responses from then on close their connections
+atomic<bool>          _draining = false;
+// Passes the listeners to a successor; see hand_off()
+tcp_server*           _handoff = NULL;
+// Set once a successor is serving; later connections to _handoff get nothing
+atomic<bool>          _handed_off = false;
+// Immutable once initialized
+header::map           _headers = {
     { "Accept", "application/json" },
     { "Access-Control-Allow-Origin", "*" },
     { "Connection", "keep-alive" },
     { "Keep-Alive", 0 },
 };
 
-int          _port = 8080;
-
-atomic<bool> _alive = true;
-mutex        _mutex;
-tcp_server*  _server = NULL;
-service      _service;
+int                   _port = 8080;
+
+// Requests framed and not yet answered, over every connection
+atomic<size_t>        _in_flight = 0;
+// Precomputed; sent without parsing anything when over capacity
+string                _overloaded;
+// Workers between loading _server and returning from post(); stop() waits them out before closing it
+atomic<size_t>        _posting = 0;
+// Read by workers without a lock; see _posting
+atomic<http_server*>  _server = NULL;
+service               _service;
+supervisor*           _supervisor = NULL;
+#if TLS
+tls_context*          _tls = NULL;
+#endif
+worker_pool*          _workers = NULL;
 
 // Non-Member Functions
 
+// Seconds in-flight requests get to finish on shutdown
+size_t drain_timeout() {
+    return 30;
+}
+
+// Back the I/O buffer pool with explicit hugepages, where the system reserves some (vm.nr_hugepages)
+bool hugepages() {
+    return false;
+}
+
 // HTTP/1.1 default
 size_t keep_alive_timeout() {
     return 5;
@@ -43,14 +117,95 @@ int keep_alive_max() {
     return 200;
 }
 
-auto sync(auto cb) {
-    _mutex.lock();
-    
-    auto result = cb();
-    
-    _mutex.unlock();
-    
-    return result;
+// Request bodies, in bytes; larger ones get the 413 before they arrive
+size_t max_body_size() {
+    return 1 << 20;
+}
+
+// Request line and headers, in bytes; larger ones get the 431
+size_t max_head_size() {
+    return 8192;
+}
+
+// Header fields per request; more get the 431
+size_t max_headers() {
+    return 100;
+}
+
+// Open connections; further ones get the 503 at accept
+size_t max_connections() {
+    return 8192;
+}
+
+// Requests queued or being answered; further ones get the 503 before they are parsed
+size_t max_in_flight() {
+    return 1024;
+}
+
+// Let a process started later take over the listeners, while this one drains and exits: a restart that refuses no
+// connection. Off to bind afresh, on the next free port if this one is taken
+bool hot_restart() {
+    return false;
+}
+
+// Seconds a successor gets to say it is serving once it has the listeners
+size_t hot_restart_timeout() {
+    return 10;
+}
+
+// Owned by this user and closed to everyone else, so no other user can bind the path or connect to it; empty if it
+// cannot be made so
+string hot_restart_directory() {
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    string      path = runtime && runtime[0] ? string(runtime) + "/http" : "/tmp/http-" + to_string(geteuid());
+    struct stat status;
+
+    // Left as it is if it exists; checked below either way
+    mkdir(path.c_str(), 0700);
+
+    if (lstat(path.c_str(), &status) || !S_ISDIR(status.st_mode) || status.st_uid != geteuid() || (status.st_mode & 077)) {
+        logger::error("hot restart: " + path + " is not a private directory");
+
+        return "";
+    }
+
+    return path;
+}
+
+// Unix socket through which the listeners pass; empty when hot_restart() is off
+string hot_restart_path() {
+    if (!hot_restart())
+        return "";
+
+    string directory = hot_restart_directory();
+
+    return directory.empty() ? "" : directory + "/" + to_string(_port) + ".sock";
+}
+
+// Worker processes, each serving the same listeners with its own heap and restarted if it dies; 0 to serve from this
+// process alone
+size_t prefork() {
+    return 0;
+}
+
+// See http_policy
+bool thread_per_core() {
+    return http_policy::thread_per_core;
+}
+
+#if TLS
+// PEM, relative to the working directory
+string tls_certificate() {
+    return "certificate.pem";
+}
+
+string tls_private_key() {
+    return "private_key.pem";
+}
+#endif
+
+bool draining() {
+    return _draining.load();
 }
 
 set<string> allow_methods() {
@@ -58,66 +213,78 @@ set<string> allow_methods() {
 }
 
 header::map headers() {
-    return sync([]() {
-        return _headers;
-    });
+    return _headers;
 }
 
-void log_request(class request request) {
-    logger::info("url: " + request.url() + ", body: " + (request.body().empty() ? "null" : request.body()));
+// Target without the query; an absolute-form target names a host first
+string path(const parser& request) {
+    string_view target = request.target();
+
+    if (target.empty() || target[0] != '/')
+        return url(string(target)).target();
+
+    return string(target.substr(0, target.find('?')));
 }
 
-string handle_request(header::map headers, class request request) {
+void log_request(const parser& request) {
+    logger::info("url: " + path(request) + ", body: " + (request.body().empty() ? "null" : string(request.body())));
+}
+
+// Routes on the parser's views; a request object is built only for the service that takes one. Status line, header
+// block and body, sent as they are; see response_buffers()
+vector<string> handle_request(header::map headers, const parser& request) {
     auto options = [](header::map headers) {
         headers["Access-Control-Allow-Methods"] = allow_methods();
 
-        return response(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
+        return response_buffers(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
     };
     
-    auto not_found = [request, &headers]() {
+    string method = tolowerstr(string(request.method())),
+           url = path(request),
+           url_prefix = "/api";
+
+    auto not_found = [&method, &url, &headers]() {
         headers["Content-Type"] = string("text/plain; charset=utf-8");
         
-        return response(NOT_FOUND, strstatus(NOT_FOUND), "Cannot " + toupperstr(request.method()) + " " + request.url(), headers);
+        return response_buffers(NOT_FOUND, strstatus(NOT_FOUND), "Cannot " + toupperstr(method) + " " + url, headers);
     };
     
-    string url = request.url(),
-            url_prefix = "/api";
     
     if (starts_with(url, url_prefix)) {
         url = url.substr(url_prefix.length());
         
         if (url == "/greeting") {
-            if (request.method() == "options") {
+            if (method == "options") {
                 headers["Accept"] = string("application/json");
 
                 return options(headers);
             }
             
-            auto greeting = [request, headers]() {
+            auto greeting = [&request, headers]() {
 #if LOGGING
                 log_request(request);
 #endif
 
-                return _service.greeting(headers, request);
+                return _service.greeting(headers, http::request(request));
             };
             
-            if (request.method() == "head") {
+            if (method == "head") {
                 greeting();
                 
-                return response(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
+                return response_buffers(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
             }
 
-            if (request.method() == "post")
+            if (method == "post")
                 return greeting();
 
             return not_found();
         }
         
         if (url == "/ping") {
-            if (request.method() == "options")
+            if (method == "options")
                 return options(headers);
             
-            auto ping = [request, headers]() {
+            auto ping = [&request, headers]() {
 #if LOGGING
                 log_request(request);
 #endif
@@ -125,13 +292,13 @@ string handle_request(header::map headers, class request request) {
                 return _service.ping(headers);
             };
             
-            if (request.method() == "head") {
+            if (method == "head") {
                 ping();
                 
-                return response(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
+                return response_buffers(NO_CONTENT, strstatus(NO_CONTENT), "", headers);
             }
 
-            if (request.method() == "get")
+            if (method == "get")
                 return ping();
 
             return not_found();
@@ -143,6 +310,271 @@ string handle_request(header::map headers, class request request) {
     return not_found();
 }
 
+// Sets close when the response is the last on its connection
+vector<string> respond(shared_ptr<struct session> session, [[maybe_unused]] const string_view text, const parser& request, bool& close) {
+#if LOGGING == LEVEL_DEBUG
+    logger::debug(string(text));
+#endif
+
+    size_t nrequest = ++session->nrequests;
+
+    close = true;
+
+    if (_counters)
+        _counters->requests++;
+
+    try {
+        if (request.header("host").empty())
+            return response_buffers(BAD_REQUEST, strstatus(BAD_REQUEST), to_string(0), {
+                { "Connection", "close" },
+                { "Transfer-Encoding", "chunked "}
+            });
+
+        string method = toupperstr(string(request.method()));
+
+        if (method != "OPTIONS" && allow_methods().count(method) == 0)
+            throw http::error(BAD_REQUEST);
+
+        close = nrequest >= keep_alive_max() || draining();
+
+        header::map headers = ::headers();
+
+        // Last response on this connection
+        if (close) {
+            headers["Connection"] = string("close");
+
+            headers.erase("Keep-Alive");
+        }
+
+        return handle_request(headers, request);
+    } catch (http::error& e) {
+        return response_buffers(BAD_REQUEST, strstatus(BAD_REQUEST), e.text(), {
+            { "Connection", "close" }
+        }, false);
+    } catch (url::error& e) {
+        // An absolute-form target that does not parse
+        return response_buffers(BAD_REQUEST, strstatus(BAD_REQUEST), "", {
+            { "Connection", "close" }
+        }, false);
+    }
+}
+
+// Sends the response with one gathered write, its body never copied behind its head; returns false once the connection
+// has been closed
+bool send_response(tcp_server::connection* connection, vector<string> response, const bool close) {
+#if LOGGING == LEVEL_DEBUG
+    logger::debug(join(response, ""));
+#endif
+
+    try {
+        connection->send(std::move(response));
+    } catch (mysocket::error& e) {
+        // Peer went away mid-response; nothing left to answer
+        connection->close();
+
+        return false;
+    }
+
+    if (close) {
+        connection->close();
+
+        return false;
+    }
+
+    // Keep alive; the next request re-arms it
+    connection->timeout(keep_alive_timeout() * 1000);
+
+    return true;
+}
+
+// Pipelined responses, corked until the last is queued so they share segments; returns false once the connection has
+// been closed
+bool send_responses(tcp_server::connection* connection, vector<vector<string>> responses, const bool close) {
+    bool corked = responses.size() > 1,
+         open = true;
+
+    if (corked)
+        connection->cork(true);
+
+    for (size_t i = 0; i < responses.size() && open; i++)
+        open = send_response(connection, std::move(responses[i]), close && i == responses.size() - 1);
+
+    // Closing flushes what is held back anyway
+    if (corked && open)
+        connection->cork(false);
+
+    return open;
+}
+
+// Answers the requests in order, up to the first that closes the connection, and sends the responses back together;
+// returns false once one has closed it
+bool handle_messages(const uint64_t id, shared_ptr<struct session> session, deque<struct message>& requests) {
+    bool                   close = false;
+    vector<vector<string>> responses;
+
+    for (size_t i = 0; i < requests.size() && !close; i++) {
+        struct message& message = requests[i];
+
+        // Moves the parser's views onto the copy; nothing is parsed again
+        message.parser.parse(message.text);
+
+        responses.push_back(respond(session, message.text, message.parser, close));
+    }
+
+    // Back on the connection's event loop, as one task; dropped if it has closed in the meantime. post() is safe from
+    // any thread; only the server's lifetime needs guarding, and _posting does that without a lock
+    _posting++;
+
+    if (http_server* server = _server.load())
+        server->post(id, [responses = std::move(responses), close](tcp_server::connection* connection) mutable {
+            send_responses(connection, std::move(responses), close);
+        });
+
+    _posting--;
+
+    return !close;
+}
+
+// Runs on a worker until the session's queue is empty
+void handle_session(const uint64_t id, shared_ptr<struct session> session) {
+    while (true) {
+        session->mutex.lock();
+
+        if (session->requests.empty()) {
+            session->busy = false;
+            session->mutex.unlock();
+
+            return;
+        }
+
+        // Everything pipelined so far, answered as one batch
+        deque<struct message> requests;
+
+        requests.swap(session->requests);
+        session->mutex.unlock();
+
+        bool keep_alive = handle_messages(id, session, requests);
+
+        // Including any left unanswered behind a close
+        _in_flight -= requests.size();
+
+        if (!keep_alive) {
+            session->mutex.lock();
+
+            // Closing; whatever else was pipelined goes unanswered
+            _in_flight -= session->requests.size();
+
+            session->requests.clear();
+            session->busy = false;
+            session->mutex.unlock();
+
+            return;
+        }
+    }
+}
+
+void handle_connection(tcp_server::connection* connection) {
+    if (_counters)
+        _counters->accepted++;
+
+    shared_ptr<struct session> session = make_shared<struct session>();
+
+    session->parser = parser({
+        .max_body = max_body_size(),
+        .max_head = max_head_size(),
+        .max_headers = max_headers()
+    });
+
+    // Kept on the connection, so the readable path needs no closure
+    connection->context(session);
+
+    // Set connection timeout, until the first request
+    connection->timeout(http::timeout() * 1000);
+}
+
+// Frames requests as they arrive on the connection's event loop; workers answer them
+void handle_input(tcp_server::connection* connection) {
+    shared_ptr<struct session> session = connection->context<struct session>();
+    bool                       close = false;
+    mysocket::buffer&          input = connection->input();
+    vector<struct message>     requests;
+    vector<vector<string>>     responses;
+
+    // Over capacity; shed the work before spending anything on it
+    if (_in_flight.load() >= max_in_flight()) {
+        connection->send(_overloaded);
+        connection->close();
+
+        return;
+    }
+
+    parser::result result = parser::INCOMPLETE;
+
+    // Every complete request received so far; a partial one is parsed as far as it goes, and resumes with more bytes
+    while (!close && (result = session->parser.parse(input.view())) == parser::COMPLETE) {
+        size_t len = session->parser.length();
+
+        // Answered right here, on this core, from the bytes in place; nothing crosses to another thread
+        if (thread_per_core())
+            responses.push_back(respond(session, input.view().substr(0, len), session->parser, close));
+        // Copied off the connection, with the parser, for a worker
+        else
+            requests.push_back({ session->parser, string(input.view().substr(0, len)) });
+
+        input.consume(len);
+        session->parser.reset();
+    }
+
+    if (result == parser::INVALID) {
+        status_code status = session->parser.status();
+
+        try {
+            connection->send(response_buffers(status, strstatus(status), "", {
+                { "Connection", "close" }
+            }, false));
+        } catch (mysocket::error& e) { }
+
+        connection->close();
+
+        return;
+    }
+
+    if (responses.size()) {
+        send_responses(connection, std::move(responses), close);
+
+        return;
+    }
+
+    if (requests.empty())
+        return;
+
+    // Re-armed once answered
+    connection->timeout(0);
+
+    _in_flight += requests.size();
+
+    session->mutex.lock();
+    session->requests.insert(session->requests.end(), make_move_iterator(requests.begin()), make_move_iterator(requests.end()));
+
+    bool busy = session->busy;
+
+    session->busy = true;
+    session->mutex.unlock();
+
+    if (!busy)
+        _workers->submit([id = connection->id(), session]() {
+            handle_session(id, session);
+        });
+}
+
+void http_handler::operator()(tcp_server::connection* connection) const {
+    handle_connection(connection);
+}
+
+void http_handler::on_readable(tcp_server::connection* connection) const {
+    handle_input(connection);
+}
+
 void initialize() {
     // Preserve comma-separated header values' order
     vector<string> keep_alive = { join({ "timeout", to_string(keep_alive_timeout()) }, "=") };
@@ -151,26 +583,322 @@ void initialize() {
         keep_alive.push_back(join({ "max", to_string(keep_alive_max()) }, "="));
 
     _headers["Keep-Alive"] = join(keep_alive, ",");
+
+    _overloaded = response(SERVICE_UNAVAILABLE, strstatus(SERVICE_UNAVAILABLE), "", {
+        { "Connection", "close" },
+        { "Content-Length", 0 },
+        { "Retry-After", 1 }
+    }, false);
+}
+
+// Blocks until SIGINT or SIGTERM asks to stop
+void wait_for_signal(const sigset_t* signals) {
+    while (true) {
+        int signum;
+
+        if (sigwait(signals, &signum))
+            continue;
+
+        // From an interactive terminal, confirm first
+        if (signum == SIGINT && isatty(STDIN_FILENO)) {
+            cout << endl;
+            cout << "Stop? (y/N) ";
+
+            string str;
+
+            getline(cin, str);
+
+            if (tolowerstr(str) != "y")
+                continue;
+        }
+
+        return;
+    }
+}
+
+struct tcp_server::options server_options() {
+    return {
+        .max_connections = max_connections(),
+        .mode = http_policy::mode,
+        .reject_message = _overloaded,
+        // Workers share them, and so may a predecessor or successor; otherwise drain() refuses new peers at once
+        .shared_listeners = prefork() || hot_restart(),
+        .thread_per_core = thread_per_core(),
+#if TLS
+        .tls = _tls
+#endif
+    };
+}
+
+// Passes the listeners to the first process to connect to hot_restart_path(), and stops this one once it says it is
+// serving them
+void hand_off(const vector<int> listeners) {
+    string path = hot_restart_path();
+
+    if (path.empty())
+        return;
+
+    try {
+        // A coroutine on one event loop: waiting on the successor holds no thread
+        _handoff = new tcp_server(path, [listeners](tcp_server::connection* connection) -> task<> {
+            if (_handed_off.load()) {
+                connection->close();
+
+                co_return;
+            }
+
+            try {
+                // Only to a process of this user, however the directory came to be reachable
+                if (connection->credentials().uid != geteuid()) {
+                    connection->close();
+
+                    co_return;
+                }
+
+                connection->send_file_descriptors(listeners, "listeners");
+            } catch (mysocket::error& e) {
+                connection->close();
+
+                co_return;
+            }
+
+            // Closes the connection if the successor neither says it is serving nor exits in time
+            connection->timeout(hot_restart_timeout() * 1000);
+
+            // Empty if the successor gave up, e.g. failing to start, or timed out; keep serving
+            if ((co_await connection->async_recv()).empty()) {
+                connection->close();
+
+                co_return;
+            }
+
+            connection->timeout(0);
+
+            _handed_off.store(true);
+
+            logger::info("Handed off to a new process");
+
+            // Closing _handoff closes the connection too, which tells the successor the path is free
+            kill(getpid(), SIGTERM);
+        }, {
+            .mode = tcp_server::EVENT_LOOP,
+            .threads = 1
+        });
+    } catch (mysocket::error& e) {
+        logger::error("hot restart: " + string(e.what()));
+    }
+}
+
+// Tells the predecessor this process is serving, and waits for it to free hot_restart_path()
+void relieve(tcp_client* predecessor) {
+    try {
+        predecessor->send("serving");
+
+        while (predecessor->recv().length())
+            continue;
+    } catch (mysocket::error& e) { }
+
+    predecessor->close();
+}
+
+// Listeners of the process already serving the port, if there is one; it goes on serving them until relieved
+vector<int> take_over(tcp_client** predecessor) {
+    vector<int> listeners;
+    string      path = hot_restart_path();
+
+    if (path.empty())
+        return listeners;
+
+    try {
+        *predecessor = new tcp_client(path);
+    } catch (mysocket::error& e) {
+        // None, or it exited without removing the socket file
+        return listeners;
+    }
+
+    try {
+        // Only from a process of this user
+        if ((*predecessor)->credentials().uid == geteuid())
+            (*predecessor)->recv(listeners);
+    } catch (mysocket::error& e) { }
+
+    if (listeners.empty()) {
+        (*predecessor)->close();
+        *predecessor = NULL;
+
+        return listeners;
+    }
+
+    struct sockaddr_in address;
+    socklen_t          address_length = sizeof(address);
+
+    if (getsockname(listeners[0], (struct sockaddr *)&address, &address_length) == 0)
+        _port = ntohs(address.sin_port);
+
+    return listeners;
+}
+
+// Serves the listeners from this process
+void start(const vector<int> listeners) {
+    _workers = new worker_pool();
+
+#if TLS
+    _tls = new tls_context({
+        .certificate = tls_certificate(),
+        .private_key = tls_private_key()
+    });
+#endif
+
+    try {
+        _server = new http_server(listeners, http_handler(), server_options());
+    } catch (mysocket::error& e) {
+        _workers->close();
+
+#if TLS
+        _tls->close();
+#endif
+
+        throw e;
+    }
 }
 
 // Perform garbage collection
-void onsignal(int signum) {
-    thread([]() {
-        cout << endl;
-        cout << "Stop? (y/N) ";
+void stop() {
+    logger::info("Draining...");
+
+    _draining.store(true);
+
+    // In-flight requests finish, answered with Connection: close
+    _server.load()->drain(drain_timeout() * 1000);
 
-        string str;
+    http_server* server = _server.exchange(NULL);
 
-        getline(cin, str);
+    // A worker that loaded the server before the exchange is done with it once _posting falls to 0
+    while (_posting.load())
+        this_thread::yield();
 
-        if (tolowerstr(str) == "y") {
-            _server->close();
-            _alive.store(false);
+    server->close();
+
+    struct worker_pool::statistics stats = _workers->stats();
+
+    logger::info("workers: " + to_string(stats.threads) + ", completed: " + to_string(stats.completed) + ", steals: " + to_string(stats.steals));
+
+    struct buffer_pool::statistics buffers = buffer_pool::stats();
+
+    logger::info("buffers: " + to_string(buffers.in_use) + " in use of " + to_string(buffers.blocks) + ", slabs: " + to_string(buffers.slabs) + ", hugepage slabs: " + to_string(buffers.hugepage_slabs));
+
+    _workers->close();
+
+#if TLS
+    struct tls_context::statistics tls_stats = _tls->stats();
+
+    logger::info("handshakes: " + to_string(tls_stats.full) + ", resumed: " + to_string(tls_stats.resumed) + ", failed: " + to_string(tls_stats.failures) + ", kTLS: " + to_string(tls_stats.ktls_send));
+
+    _tls->close();
+#endif
+}
+
+// Drives nrequests through everything above the socket (framing, workers, parsing, handlers, responses) over
+// in-process loopbacks, pipelined up to the keep-alive limit per connection, and reports the throughput
+void benchmark(const size_t nrequests) {
+    const string request = "GET /api/ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    _workers = new worker_pool();
+    _server = new http_server(http_handler(), tcp_server::options());
+
+    condition_variable condition;
+    bool               ready = false;
+    mutex              ready_mutex;
+    size_t             responses = 0;
+    auto               start = chrono::steady_clock::now();
+
+    while (responses < nrequests) {
+        auto [client, peer] = loopback::pair();
+
+        client->on_ready([&](const int) {
+            lock_guard<std::mutex> lock(ready_mutex);
+
+            ready = true;
+
+            condition.notify_one();
+        });
+
+        _server.load()->open(peer);
+
+        size_t batch = keep_alive_max() > 0 ? min(nrequests - responses, (size_t) keep_alive_max()) : nrequests - responses,
+               received = 0,
+               sent = 0;
+        string input,
+               output;
+
+        for (size_t i = 0; i < batch; i++)
+            output += request;
+
+        while (received < batch) {
+            while (sent < output.length()) {
+                struct iovec iov = { output.data() + sent, output.length() - sent };
+                ssize_t      len = client->send(&iov, 1);
+
+                if (len == -1)
+                    break;
+
+                sent += len;
+            }
+
+            char    buff[1 << 16];
+            ssize_t len;
+
+            while ((len = client->recv(buff, sizeof(buff))) > 0) {
+                input.append(buff, len);
+
+                // Counted by status line; the body says nothing that looks like one
+                for (size_t pos = input.find("HTTP/1.1 "); pos != string::npos; pos = input.find("HTTP/1.1 ", pos + 1))
+                    received++;
+
+                // Enough to finish a status line split across reads, not enough to count one twice
+                input.erase(0, input.length() > 8 ? input.length() - 8 : 0);
+            }
+
+            // Answered, or closed by the server
+            if (received >= batch || len == 0)
+                break;
+
+            unique_lock<std::mutex> lock(ready_mutex);
+
+            condition.wait(lock, [&ready]() {
+                return ready;
+            });
+
+            ready = false;
         }
-    }).detach();
+
+        responses += received;
+
+        // Turned away, e.g. overloaded
+        if (received == 0)
+            break;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << responses << " requests in " << seconds << "s: " << (size_t) (responses / seconds) << " requests/s\n";
+
+    stop();
 }
 
 int main(int argc, const char* argv[]) {
+    buffer_pool::configure({
+        .hugepages = hugepages()
+    });
+
+    // http --bench [requests]
+    if (argc != 1 && string(argv[1]) == "--bench") {
+        initialize();
+        benchmark(argc > 2 ? max(parse_int(argv[2]), 1) : 1000000);
+
+        return 0;
+    }
+
     if (argc != 1) {
         _port = parse_int(argv[1]);
 
@@ -180,126 +908,85 @@ int main(int argc, const char* argv[]) {
 
     initialize();
 
-    while (true) {
-        try {
-            _server = new tcp_server(_port, [](tcp_server::connection* connection) {
-                // Number of requests received
-                atomic<size_t> nrequests = 0;
-                
-                // Handle request in its own thread
-                thread([&nrequests, connection]() {
-                    // Set connection timeout
-                    thread([&nrequests, connection]() {
-                        for (size_t i = 0; i < http::timeout() && !nrequests.load(); i++)
-                            this_thread::sleep_for(chrono::milliseconds(1000));
-
-                        if (nrequests.load())
-                            return;
-
-                        nrequests.store(1);
-                        connection->close();
-                    }).detach();
-
-                    // Wait for non-empty request
-                    while (true) {
-                        try {
-                            string request = connection->recv();
-
-                            if (request.empty())
-                                continue;
-
-                            logger::debug(request);
-
-                            nrequests.fetch_add(1);
-
-                            auto handle_response = [connection](const string response) {
-                                logger::debug(response);
-
-                                connection->send(response);
-                            };
-
-                            try {
-                                class request request_obj = parse_request(request);
-
-                                if (request_obj.headers()["host"].str().length()) {
-                                    auto next = [&]() {
-                                        string response = handle_request(headers(), request_obj);
-
-                                        handle_response(response);
-
-                                        size_t nrequest = nrequests.load();
-
-                                        if (nrequest >= keep_alive_max()) {
-                                            connection->close();
-                                            
-                                            return true;
-                                        }
-
-                                        // Keep alive
-                                        thread([nrequest, &nrequests, connection]() {
-                                            for (int i = 0; i < keep_alive_timeout() && nrequest == nrequests.load(); i++)
-                                                this_thread::sleep_for(chrono::milliseconds(1000));
-
-                                            if (nrequest == nrequests.load())
-                                                connection->close();
-                                        }).detach();
-                                        
-                                        return false;
-                                    };
-
-                                    string method = toupperstr(request_obj.method());
-                                    
-                                    if (method == "OPTIONS") {
-                                        if (next())
-                                            return;
-                                    } else {
-                                        if (allow_methods().find(method) == allow_methods().end())
-                                            throw http::error(BAD_REQUEST);
-                                            
-                                        if (next())
-                                            return;
-                                    }
-                                } else {
-                                    handle_response(response(BAD_REQUEST, strstatus(BAD_REQUEST), to_string(0), {
-                                        { "Connection", "close" },
-                                        { "Transfer-Encoding", "chunked "}
-                                    }));
-
-                                    return connection->close();
-                                }
-                            } catch (http::error& e) {
-                                handle_response(response(BAD_REQUEST, strstatus(BAD_REQUEST), e.text(), {
-                                    { "Connection", "close" }
-                                }, false));
-                        
-                                return connection->close();
-                            }
-                        } catch (mysocket::error& e) {
-                            // Connection timed out; suppress error
-                            if (nrequests.load())
-                                return;
-
-                            throw e;
-                        }
-                    }
-                }).detach();
-            });
-            
-            signal(SIGINT, onsignal);
-            signal(SIGTERM, onsignal);
+    sigset_t signals;
 
-            cout << "Server listening on port " << _port << "...\n";
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
 
-            while (_alive.load())
-                continue;
+    // Blocked before any thread starts, so every thread inherits the mask and only sigwait() sees them
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
 
-            break;
+    tcp_client* predecessor = NULL;
+    // A preforked worker, run again by the supervisor, has them already
+    vector<int> listeners = supervisor::inherited();
+
+    if (listeners.empty())
+        listeners = take_over(&predecessor);
+
+    while (listeners.empty()) {
+        try {
+            // Bound once, here; the server, every preforked worker and any successor share them
+            listeners = tcp_server::listen(_port, server_options());
         } catch (mysocket::error& e) {
-            // EADDRINUSE
-            if (e.errnum() == 48)
+            if (e.errnum() == EADDRINUSE)
                 _port++;
             else
                 throw e;
         }
     }
+
+    if (prefork())
+        _supervisor = new supervisor([listeners](const size_t, supervisor::counters* counters) {
+            sigset_t signals;
+
+            // Stops when the supervisor says so; SIGINT from the terminal reaches the whole process group
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGTERM);
+
+            _counters = counters;
+
+            start(listeners);
+            wait_for_signal(&signals);
+            stop();
+        }, {
+            .arguments = vector<string>(argv, argv + argc),
+            .file_descriptors = listeners,
+            .workers = prefork()
+        });
+    else
+        start(listeners);
+
+    // Accepting; the predecessor drains what it has and exits
+    if (predecessor)
+        relieve(predecessor);
+
+    hand_off(listeners);
+
+    cout << "Server listening on port " << _port << (prefork() ? " with " + to_string(prefork()) + " workers" : "") << "...\n";
+
+    wait_for_signal(&signals);
+
+    // Frees the path for a successor before draining
+    if (_handoff)
+        _handoff->close();
+
+    if (prefork() == 0) {
+        stop();
+
+        return 0;
+    }
+
+    logger::info("Stopping workers...");
+
+    _supervisor->stop();
+
+    struct supervisor::statistics stats = _supervisor->stats();
+
+    logger::info("accepted: " + to_string(stats.accepted) + ", requests: " + to_string(stats.requests) + ", restarts: " + to_string(stats.restarts));
+
+    _supervisor->close();
+
+    for (int file_descriptor: listeners)
+        close(file_descriptor);
 }
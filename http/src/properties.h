@@ -15,4 +15,7 @@
 
 #define LOGGING LEVEL_INFO
 
+// Serve HTTPS through tcp_server::options.tls; requires OpenSSL 3 (link libssl and libcrypto)
+#define TLS 0
+
 #endif /* properties_h */
@@ -7,14 +7,14 @@
 
 #include "service.h"
 
-string service::greeting(header::map headers, class request request) {
+vector<string> service::greeting(header::map headers, class request request) {
     url host(request.headers()["host"]);
 
-    return redirect(headers, PERMANENT_REDIRECT, "http://" + host.host() + ":" + to_string(((int) host.port()) + 1) + request.url());
+    return redirect_buffers(headers, PERMANENT_REDIRECT, "http://" + host.host() + ":" + to_string(((int) host.port()) + 1) + request.url());
 }
 
-string service::ping(header::map headers) {
+vector<string> service::ping(header::map headers) {
     headers["Content-Type"] = string("text/plain; charset=utf-8");
 
-    return response("Hello, world!", headers);
+    return response_buffers(OK, strstatus(OK), "Hello, world!", headers);
 }
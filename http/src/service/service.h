@@ -15,9 +15,9 @@ using namespace http;
 using namespace std;
 
 struct service {
-    string greeting(header::map headers, class request request);
+    vector<string> greeting(header::map headers, class request request);
     
-    string ping(header::map headers);
+    vector<string> ping(header::map headers);
 };
 
 #endif /* service_h */
@@ -8,35 +8,259 @@
 #include "socket.h"
 
 namespace mysocket {
+    // Non-Member Fields
+
+    // Minimum free space per read. Input buffers shrink back to a pool block after a large request, and give the
+    // block back once drained, so idle connections hold none
+    const size_t INPUT_BUFFER_SIZE = 4096;
+
+    // Provided receive buffers per io_uring loop
+    const size_t URING_BUFFER_COUNT = 1024;
+    const size_t URING_BUFFER_SIZE = 4096;
+
+#ifdef __linux__
+#ifndef UDP_SEGMENT
+    // Older headers; the kernel side landed in 4.18 (UDP_SEGMENT) and 5.0 (UDP_GRO)
+    const int UDP_SEGMENT = 103;
+#endif
+
+#ifndef UDP_GRO
+    const int UDP_GRO = 104;
+#endif
+
+    // Segments the kernel takes in one UDP_SEGMENT send
+    const size_t UDP_MAX_SEGMENTS = 64;
+#endif
+
+    // Largest payload an IPv4 datagram carries
+    const size_t UDP_MAX_PAYLOAD = 65507;
+
+    // Descriptors one message passes; Linux's SCM_MAX_FD
+    const size_t MAX_PASSED_FILE_DESCRIPTORS = 253;
+
+    // Low bits of a connection id that index its table; the table's tag sits above them
+    const int    CONNECTION_INDEX_BITS = 24;
+
+    // Thread-per-core: at most one table per tag
+    const size_t MAX_CORES = 256;
+
+    // Milliseconds a THREADED accept loop on an adopted listener waits for a connection before checking for shutdown
+    const int    ADOPTED_POLL_TIMEOUT = 100;
+
+#if TLS
+    // Largest TLS record payload; smaller queued buffers are joined up to it
+    const size_t TLS_RECORD_SIZE = 16384;
+#endif
+
+#ifndef MSG_MORE
+    // Linux only; TCP_NOPUSH via cork() covers it elsewhere
+    const int MSG_MORE = 0;
+#endif
+
+#ifndef MSG_CMSG_CLOEXEC
+    // Linux only; descriptors received elsewhere stay open across exec
+    const int MSG_CMSG_CLOEXEC = 0;
+#endif
+
+#ifndef MSG_ZEROCOPY
+    // Linux only; options.zerocopy_threshold is cleared elsewhere
+    const int MSG_ZEROCOPY = 0;
+#endif
+
     // Non-Member Functions
 
-    std::string _recv(const int file_descriptor) {
-        char buff[1024] = {0};
-            
-        ssize_t len = recv(file_descriptor, buff, 1024, 0);
+    // CPUs the process may run on, ascending
+    std::vector<int> _allowed_cpus() {
+        std::vector<int> result;
 
-        if (len == -1)
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int i = 0; i < CPU_SETSIZE; i++)
+                if (CPU_ISSET(i, &set))
+                    result.push_back(i);
+#endif
+
+        if (result.empty())
+            for (int i = 0; i < (int) std::max(std::thread::hardware_concurrency(), 1U); i++)
+                result.push_back(i);
+
+        return result;
+    }
+
+    // SO_PEERCRED, or getpeereid() where that is missing
+    struct credentials _credentials(const int file_descriptor) {
+        struct credentials result;
+
+#if defined(SO_PEERCRED)
+        struct ucred ucred;
+        socklen_t    len = sizeof(ucred);
+
+        if (getsockopt(file_descriptor, SOL_SOCKET, SO_PEERCRED, &ucred, &len))
             throw mysocket::error(errno);
 
-        buff[len] = '\0';
-        
-        return trim_end(std::string(buff));
+        result.pid = ucred.pid;
+        result.uid = ucred.uid;
+        result.gid = ucred.gid;
+#else
+        if (getpeereid(file_descriptor, &result.uid, &result.gid))
+            throw mysocket::error(errno);
+
+#if defined(LOCAL_PEERPID)
+        socklen_t len = sizeof(result.pid);
+
+        // Best effort; the ids above are what access checks need
+        if (getsockopt(file_descriptor, SOL_LOCAL, LOCAL_PEERPID, &result.pid, &len))
+            result.pid = -1;
+#endif
+#endif
+
+        return result;
     }
 
-    int _send(const int file_descriptor, const std::string message) {
-        ssize_t len = ::send(file_descriptor, message.c_str(), message.length(), MSG_NOSIGNAL);
-            
+    int _connect(const int file_descriptor, const struct sockaddr* address, const socklen_t address_length, const int timeout) {
+        if (timeout < 0)
+            return connect(file_descriptor, address, address_length);
+
+        set_nonblocking(file_descriptor);
+
+        int result = connect(file_descriptor, address, address_length);
+
+        if (result == -1 && errno == EINPROGRESS) {
+            struct pollfd pfd = { file_descriptor, POLLOUT, 0 };
+            int           ready = poll(&pfd, 1, timeout);
+
+            if (ready == 0)
+                errno = ETIMEDOUT;
+
+            if (ready != 1)
+                return -1;
+
+            int       errnum = 0;
+            socklen_t len = sizeof(errnum);
+
+            if (getsockopt(file_descriptor, SOL_SOCKET, SO_ERROR, &errnum, &len) || errnum) {
+                errno = errnum ? errnum : errno;
+
+                return -1;
+            }
+
+            result = 0;
+        }
+
+        // Blocking again for recv() and send()
+        fcntl(file_descriptor, F_SETFL, fcntl(file_descriptor, F_GETFL, 0) & ~O_NONBLOCK);
+
+        return result;
+    }
+
+    // A path starting with '@' names an abstract socket: a leading NUL, and no terminator
+    socklen_t _unix_address(const std::string path, struct sockaddr_un* address) {
+        memset(address, 0, sizeof(* address));
+
+        address->sun_family = AF_UNIX;
+
+        if (path.empty() || path.length() >= sizeof(address->sun_path))
+            throw mysocket::error(ENAMETOOLONG);
+
+        memcpy(address->sun_path, path.data(), path.length());
+
+        if (path[0] != '@')
+            return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path.length() + 1);
+
+        address->sun_path[0] = '\0';
+
+        return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path.length());
+    }
+
+    size_t _recv(const int file_descriptor, buffer& buff) {
+        // prepare() first; argument evaluation order is unspecified
+        char*   tail = buff.prepare(INPUT_BUFFER_SIZE);
+        ssize_t len = recv(file_descriptor, tail, buff.writable(), 0);
+
         if (len == -1)
             throw mysocket::error(errno);
-        
-        return (int) len;
+
+        buff.commit(len);
+
+        return len;
+    }
+
+    int _send(const int file_descriptor, struct iovec* iov, size_t count) {
+        size_t total = 0;
+
+        while (count) {
+            size_t        batch = std::min(count, (size_t) IOV_MAX);
+            struct msghdr message;
+
+            memset(&message, 0, sizeof(message));
+
+            message.msg_iov = iov;
+            message.msg_iovlen = batch;
+
+            // More follows this batch; let the kernel hold back a partial segment
+            ssize_t len = sendmsg(file_descriptor, &message, MSG_NOSIGNAL | (batch < count ? MSG_MORE : 0));
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                // Non-blocking socket; wait until the kernel can take more
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    struct pollfd pfd = { file_descriptor, POLLOUT, 0 };
+
+                    poll(&pfd, 1, -1);
+
+                    continue;
+                }
+
+                throw mysocket::error(errno);
+            }
+
+            total += len;
+
+            // Skip what was written, resuming mid-buffer after a short write
+            for (; count && (size_t) len >= iov->iov_len; iov++, count--)
+                len -= iov->iov_len;
+
+            if (count) {
+                iov->iov_base = (char *)iov->iov_base + len;
+                iov->iov_len -= len;
+            }
+        }
+
+        return (int) total;
+    }
+
+    // Confines the calling thread to the CPU; best effort, and a no-op where threads cannot be pinned
+    void _pin(const int cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+
+    int _send(const int file_descriptor, const std::string message) {
+        struct iovec iov = { (void *)message.c_str(), message.length() };
+
+        return _send(file_descriptor, &iov, 1);
     }
 
     // Constructors
 
-    tcp_server::connection::connection(tcp_server* parent, const int file_descriptor) {
+    tcp_server::connection::connection(tcp_server* parent) {
         this->_parent = parent;
-        this->_file_descriptor = file_descriptor;
+    }
+
+    tcp_server::connection_table::connection_table(const uint32_t tag) {
+        this->_tag = tag;
     }
 
     error::error(const int errnum) {
@@ -44,100 +268,120 @@ namespace mysocket {
         this->_what = std::strerror(this->_errnum);
     }
 
-    tcp_client::tcp_client(const std::string host, const int port) {
-        this->_file_descriptor = ::socket(AF_INET, SOCK_STREAM, 0);
-            
-        if (this->_file_descriptor == -1)
-            throw mysocket::error(errno);
-        
-        struct sockaddr_in addr;
+    error::error(const int errnum, const std::string what) {
+        this->_errnum = errnum;
+        this->_what = what;
+    }
 
-        // IPv4
-        addr.sin_family = AF_INET;
+    tcp_client::tcp_client(const std::string path): tcp_client(path, 0) { }
 
-        // Convert port to network byte order
-        addr.sin_port = htons(port);
-        
-        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == -1)
-            throw mysocket::error(errno);
-        
-        // Returns 0 for success, -1 otherwise
-        if (connect(this->_file_descriptor, (struct sockaddr *)&addr, sizeof(addr))) {
-            ::close(this->_file_descriptor);
-            
-            throw mysocket::error(errno);
-        }
-    }
+    tcp_client::tcp_client(const std::string host, const int port, const int timeout) {
+        if (host.length() && (host[0] == '/' || host[0] == '@')) {
+            struct sockaddr_un address;
+            socklen_t          address_length = _unix_address(host, &address);
 
-    tcp_server::tcp_server(const int port, const int backlog) {
-        this->_file_descriptor = ::socket(AF_INET, SOCK_STREAM, 0);
-            
-        if (this->_file_descriptor == -1)
-            throw mysocket::error(errno);
-                
-        int opt = 1;
-        
-        if (setsockopt(this->_file_descriptor, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-            ::close(this->_file_descriptor);
-            
-            throw mysocket::error(errno);
-        }
-            
-        // Listen for any IP address
-        this->_address.sin_addr.s_addr = INADDR_ANY;
+            this->_file_descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
 
-        // IPv4
-        this->_address.sin_family = AF_INET;
+            if (this->_file_descriptor == -1)
+                throw mysocket::error(errno);
 
-        // Convert port to network byte order
-        this->_address.sin_port = htons(port);
-        this->_address_length = sizeof(this->_address);
-        
-        if (bind(this->_file_descriptor, (struct sockaddr *)&this->_address, this->_address_length)) {
-            ::close(this->_file_descriptor);
-            
-            throw mysocket::error(errno);
-        }
-        
-        if (listen(this->_file_descriptor, backlog)) {
-            ::close(this->_file_descriptor);
-            
-            throw mysocket::error(errno);
+            if (_connect(this->_file_descriptor, (struct sockaddr *)&address, address_length, timeout)) {
+                int errnum = errno;
+
+                ::close(this->_file_descriptor);
+
+                throw mysocket::error(errnum);
+            }
+
+            return;
         }
-        
-        this->_listener = std::thread([&]{
-            while (true) {
-                if (this->_shut_down.load())
-                    return;
-                
-                // Returns nonnegative file descriptor or -1 for error
-                int file_descriptor = accept(
-                    this->_file_descriptor,
-                    (struct sockaddr *)&this->_address, (socklen_t *)&this->_address_length);
-                
-                if (file_descriptor == -1)
+
+        struct addrinfo  hints;
+        struct addrinfo* result;
+
+        memset(&hints, 0, sizeof(hints));
+
+        // IPv4 or IPv6, by name or numeric address
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+
+        if (status)
+            throw mysocket::error(status == EAI_SYSTEM ? errno : EHOSTUNREACH, gai_strerror(status));
+
+        int errnum = EHOSTUNREACH;
+
+        this->_file_descriptor = -1;
+
+        // First address that accepts the connection
+        for (struct addrinfo* address = result; address && this->_file_descriptor == -1; address = address->ai_next) {
+            int file_descriptor = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+            if (file_descriptor == -1) {
+                errnum = errno;
+
+                continue;
+            }
+
+            try {
+                if (_connect(file_descriptor, address->ai_addr, address->ai_addrlen, timeout) == 0) {
+                    this->_file_descriptor = file_descriptor;
+
                     continue;
+                }
 
-                class connection* connection = new class connection(this, file_descriptor);
-                
-                this->_mutex.lock();
-                this->_connections.push_back(connection);
-                
-                // Sort into place
-                for (size_t i = this->_connections.size() - 1; i > 0 && this->_connections[i] < this->_connections[i - 1]; i--)
-                    std::swap(this->_connections[i], this->_connections[i - 1]);
-                
-                this->_mutex.unlock();
-                this->_handler(connection);
+                errnum = errno;
+            } catch (mysocket::error& e) {
+                errnum = e.errnum();
             }
-        });
+
+            ::close(file_descriptor);
+        }
+
+        freeaddrinfo(result);
+
+        if (this->_file_descriptor == -1)
+            throw mysocket::error(errnum);
     }
 
-    tcp_server::tcp_server(const int port, const std::function<void(connection*)> handler, const int backlog): tcp_server(port, backlog) {
-        this->_handler = handler;
+    tcp_server::tcp_server(const int port, const int backlog): tcp_server(port, [](class connection*) { }, { .backlog = backlog }) { }
+
+    tcp_server::tcp_server(const int port, const std::function<void(connection*)> handler, const int backlog): tcp_server(port, handler, { .backlog = backlog }) { }
+
+    tcp_server::tcp_server() {
+        // AF_UNSPEC until bound
+        memset(&this->_address, 0, sizeof(this->_address));
+    }
+
+    tcp_server::tcp_server(const int port, const std::function<void(connection*)> handler, const struct options options) {
+        this->_inet(port);
+        this->_start(handler, options);
+    }
+
+    tcp_server::tcp_server(const std::string path, const std::function<void(connection*)> handler, const int backlog): tcp_server(path, handler, { .backlog = backlog }) { }
+
+    tcp_server::tcp_server(const std::string path, const std::function<void(connection*)> handler, const struct options options) {
+        this->_unix(path);
+        this->_start(handler, options);
+    }
+
+    tcp_server::tcp_server(const std::vector<int> file_descriptors, const std::function<void(connection*)> handler, const struct options options) {
+        this->_adopt(file_descriptors);
+        this->_start(handler, options);
+    }
+
+    tcp_server::tcp_server(const std::function<void(connection*)> handler, const struct options options): tcp_server() {
+        this->_start(handler, options);
+    }
+
+    tcp_server::shard::shard(const int file_descriptor) {
+        this->_file_descriptor = file_descriptor;
     }
 
-    udp_client::udp_client(const std::string host, const int port) {
+    udp_client::udp_client(const std::string host, const int port): udp_client(host, port, options()) { }
+
+    udp_client::udp_client(const std::string host, const int port, const struct options options): udp_socket(options) {
         this->_file_descriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
             
         if (this->_file_descriptor == -1)
@@ -158,9 +402,13 @@ namespace mysocket {
             
             throw mysocket::error(errno);
         }
+
+        this->_configure();
     }
 
-    udp_server::udp_server(const int port) {
+    udp_server::udp_server(const int port): udp_server(port, options()) { }
+
+    udp_server::udp_server(const int port, const struct options options): udp_socket(options) {
         this->_file_descriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
             
         if (this->_file_descriptor == -1)
@@ -190,13 +438,38 @@ namespace mysocket {
         this->_address = new struct sockaddr_in();
         
         memset(this->_address, 0, sizeof(* this->_address));
+
+        this->_configure();
+    }
+
+    udp_socket::udp_socket(const struct options options) {
+        this->_options = options;
+        this->_options.batch_size = std::max(this->_options.batch_size, (size_t) 1);
+        this->_options.max_datagram_size = std::clamp(this->_options.max_datagram_size, (size_t) 1, UDP_MAX_PAYLOAD);
     }
 
     tcp_server::connection::~connection() { }
 
+    tcp_server::connection_table::~connection_table() {
+        for (size_t i = 0; i < MAX_CHUNKS; i++) {
+            slot* chunk = this->_chunks[i].load();
+
+            if (chunk == NULL)
+                continue;
+
+            for (size_t j = 0; j < CHUNK_SIZE; j++)
+                delete chunk[j].connection;
+
+            delete[] chunk;
+        }
+    }
+
     tcp_client::~tcp_client() { }
 
-    tcp_server::~tcp_server() { }
+    tcp_server::~tcp_server() {
+        for (connection_table* table: this->_tables)
+            delete table;
+    }
 
     udp_client::~udp_client() { }
 
@@ -204,141 +477,2545 @@ namespace mysocket {
 
     // Member Functions
 
-    void tcp_server::connection::_close() {
-        if (::close(this->_file_descriptor))
-            throw mysocket::error(errno);
-
-        delete this;
-    }
+    void tcp_server::_accept(shard* shard) {
+        // Edge-triggered; drain every pending connection
+        while (true) {
+            // Leave the rest of a shared queue to the other processes
+            if (this->_adopted && this->_draining.load())
+                return;
 
-    int tcp_server::_find_connection(const class connection* connection) {
-        return this->_find_connection(connection, 0, this->_connections.size());
-    }
+#ifdef __linux__
+            // Non-blocking and close-on-exec from the start, without two more system calls
+            int file_descriptor = accept4(shard->_file_descriptor, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+            int file_descriptor = accept(shard->_file_descriptor, NULL, NULL);
+#endif
 
-    int tcp_server::_find_connection(const class connection* connection, const size_t start, const size_t end) {
-        if (start == end)
-            return -1;
-        
-        size_t len = floor((end - start) / 2);
-        
-        if (this->_connections[start + len] == connection)
-            return (int) (start + len);
-        
-        if (this->_connections[start + len] > connection)
-            return this->_find_connection(connection, start, start + len);
-        
-        return this->_find_connection(connection, start + len + 1, end);
-    }
+            if (file_descriptor == -1) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
 
-    void tcp_server::connection::close() {
-        this->_parent->close(this);
-    }
+                // The descriptor check comes first, so this also fails with nothing pending
+                if ((errno == EMFILE || errno == ENFILE) && this->_shed(shard->_file_descriptor))
+                    continue;
 
-    void tcp_client::close() {
-        if (::close(this->_file_descriptor)) 
-            throw mysocket::error(errno);
+                return;
+            }
 
-        delete this;
-    }
+            // Handshakes the kernel completed after drain() began
+            if (this->_draining.load()) {
+                ::close(file_descriptor);
 
-    void tcp_server::close() {
-        this->_shut_down.store(true);
-        this->_mutex.lock();
-        
-        if (::close(this->_file_descriptor)) {
-            this->_mutex.unlock();
+                continue;
+            }
 
-            throw mysocket::error(errno);
-        }
-        
-        this->_listener.join();
+            if (!this->_admit(file_descriptor, shard))
+                continue;
 
-        for (size_t i = 0; i < this->_connections.size(); i++) {
-            if (::close(this->_connections[i]->_file_descriptor)) {
-                this->_mutex.unlock();
+#ifndef __linux__
+            try {
+                set_nonblocking(file_descriptor);
+            } catch (mysocket::error& e) {
+                ::close(file_descriptor);
 
-                throw mysocket::error(errno);
+                continue;
             }
-                
-            delete this->_connections[i];
-        }
+#endif
 
-        this->_mutex.unlock();
-        
-        delete this;
-    }
+            event_loop*       loop = shard->_loop ? shard->_loop : this->_loops[this->_next_loop.fetch_add(1) % this->_loops.size()];
+            class connection* connection;
 
-    void udp_socket::close() {
-        if (::close(this->_file_descriptor))
-            throw mysocket::error(errno);
-        
-        delete this->_address;
-        delete this;
-    }
+            try {
+                connection = this->_open(file_descriptor, shard, loop);
+            } catch (mysocket::error& e) {
+                continue;
+            }
 
-    void tcp_server::close(class connection* connection) {
-        this->_mutex.lock();
-        
-        int index = this->_find_connection(connection);
+            this->_watch(connection);
 
-        if (index == -1)
-            return this->_mutex.unlock();
+            // Confine the connection to its loop: the handler, callbacks and close all run there
+            connection->_loop->post([this, connection]() {
+                if (connection->_closed.load() || this->_shut_down.load())
+                    return;
 
-        try {
-            connection->_close();
-        } catch (mysocket::error& e) {
-            this->_mutex.unlock();
+                this->_arm(connection);
 
-            throw e;
+                // Registered first, so a send from the handler can wait for writability
+                connection->_loop->add(&connection->_watcher, event_loop::READABLE);
+
+                this->_handler(connection);
+            });
         }
+    }
+
+    void tcp_server::_accept_stopped() {
+        std::lock_guard<std::mutex> lock(this->_drain_mutex);
 
-        this->_connections.erase(this->_connections.begin() + index);
-        this->_mutex.unlock();
+        this->_accepting--;
+        this->_drain_condition.notify_all();
     }
 
-    std::vector<tcp_server::connection*> tcp_server::connections() {
-        this->_mutex.lock();
+    void tcp_server::_adopt(const std::vector<int> file_descriptors) {
+        if (file_descriptors.empty())
+            throw mysocket::error(EINVAL);
 
-        std::vector<connection*> temp = this->_connections;
+        memset(&this->_address, 0, sizeof(this->_address));
 
-        this->_mutex.unlock();
+        this->_address_length = sizeof(this->_address);
 
-        return temp;
-    }
+        if (getsockname(file_descriptors[0], (struct sockaddr *)&this->_address, &this->_address_length))
+            throw mysocket::error(errno);
 
-    int error::errnum() const {
-        return this->_errnum;
-    }
+        for (int file_descriptor: file_descriptors)
+            this->_shards.push_back(new shard(file_descriptor));
 
-    std::string tcp_server::connection::recv() const {
-        return _recv(this->_file_descriptor);
+        this->_adopted = true;
     }
 
-    std::string tcp_client::recv() const {
-        return _recv(this->_file_descriptor);
+    bool tcp_server::_admit(const int file_descriptor, shard* shard) {
+        size_t share = (this->_options.max_connections + this->_tables.size() - 1) / this->_tables.size();
+
+        if (this->_options.max_connections == 0 || shard->_connections->size() < share)
+            return true;
+
+        this->_reject(file_descriptor);
+
+        return false;
+    }
+
+    void tcp_server::_arm(class connection* connection) {
+        // Set once per pooled object; a connection's timers are cancelled before it is reused
+        if (connection->_deadline.callback == nullptr) {
+            connection->_deadline.callback = [this, connection]() {
+                this->close(connection);
+            };
+            connection->_idle.callback = connection->_deadline.callback;
+        }
+
+        if (this->_options.idle_timeout)
+            connection->_loop->timers().add(&connection->_idle, this->_options.idle_timeout);
+    }
+
+    void tcp_server::_drained(class connection* connection) {
+        if (connection->_congested.load() && connection->_output_size.load() <= this->_options.low_watermark) {
+            connection->_congested.store(false);
+
+            if (connection->_on_writable)
+                connection->_on_writable(connection);
+        }
+
+        // The callback may have closed it
+        if (connection->_closed.load())
+            return;
+
+        connection->_resume();
+
+        // Zero-copy sends still read from what they pinned
+        if (connection->_closing && connection->_output.empty() && connection->_zerocopy_held.empty())
+            this->close(connection);
+    }
+
+    void tcp_server::_flush(class connection* connection) {
+        if (connection->_closed.load())
+            return;
+
+#if TLS
+        // Sent once the handshake completes
+        if (connection->_handshaking)
+            return;
+#endif
+
+        // Out of socket memory for notifications; copy for the rest of this flush
+        bool copy = false;
+
+        while (connection->_output.size()) {
+            size_t offset = connection->_output_offset,
+                   threshold = connection->_zerocopy && !copy ? this->_options.zerocopy_threshold : SIZE_MAX;
+            // Sent alone, so what it pins is just that message
+            bool   zerocopy = connection->_output.front().view().length() - offset >= threshold;
+
+            connection->_output_iov.clear();
+
+            for (size_t i = 0; i < connection->_output.size() && connection->_output_iov.size() < IOV_MAX; i++) {
+                std::string_view message = connection->_output[i].view();
+
+                // Left for a zero-copy send of its own
+                if (i && message.length() >= threshold)
+                    break;
+
+                connection->_output_iov.push_back({ (char *)message.data() + offset, message.length() - offset });
+
+                offset = 0;
+
+                if (zerocopy)
+                    break;
+            }
+
+            memset(&connection->_output_message, 0, sizeof(connection->_output_message));
+
+            connection->_output_message.msg_iov = connection->_output_iov.data();
+            connection->_output_message.msg_iovlen = connection->_output_iov.size();
+
+            ssize_t len = connection->_send(&connection->_output_message, zerocopy ? MSG_ZEROCOPY : 0);
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                if (errno == ENOBUFS && zerocopy) {
+                    copy = true;
+
+                    continue;
+                }
+
+                // Peer went away
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return this->close(connection);
+
+                // Full; edge-triggered, so this fires once the peer has read enough to make room
+                if (!connection->_sending) {
+                    connection->_sending = true;
+
+                    this->_modify(connection, event_loop::READABLE | event_loop::WRITABLE);
+                }
+
+                break;
+            }
+
+            if (zerocopy) {
+                connection->_output.front().zerocopy = true;
+                connection->_output.front().zerocopy_id = connection->_zerocopy_next++;
+
+                this->_zerocopy_sends.fetch_add(1);
+            }
+
+            connection->_consume(len);
+        }
+
+        if (connection->_output.empty() && connection->_sending) {
+            connection->_sending = false;
+
+            this->_modify(connection, event_loop::READABLE);
+        }
+
+        this->_drained(connection);
+    }
+
+    bool tcp_server::_handshake([[maybe_unused]] class connection* connection) {
+#if TLS
+        int result = SSL_do_handshake(connection->_tls);
+
+        if (result == 1) {
+            connection->_handshaking = false;
+            connection->_tls_offloaded = BIO_get_ktls_send(SSL_get_wbio(connection->_tls));
+
+            this->_options.tls->_handshaken(connection->_tls);
+
+            return true;
+        }
+
+        int error = SSL_get_error(connection->_tls, result);
+
+        // Edge-triggered; the rest of the flight wakes the loop again
+        if (error == SSL_ERROR_WANT_READ)
+            return false;
+
+        if (error == SSL_ERROR_WANT_WRITE) {
+            // Full; continue once the peer has read
+            if (!connection->_sending) {
+                connection->_sending = true;
+
+                this->_modify(connection, event_loop::READABLE | event_loop::WRITABLE);
+            }
+
+            return false;
+        }
+
+        this->_options.tls->_failed();
+
+        if (this->_options.mode != THREADED)
+            this->close(connection);
+
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    void tcp_server::connection::_consume(const size_t len) {
+        size_t remaining = len + this->_output_offset;
+
+        // A short write resumes mid-buffer
+        while (this->_output.size() && remaining >= this->_output.front().view().length()) {
+            remaining -= this->_output.front().view().length();
+
+            // Pinned until its last zero-copy send completes
+            if (this->_output.front().zerocopy && this->_output.front().zerocopy_id >= this->_zerocopy_done)
+                this->_zerocopy_held.push_back(std::move(this->_output.front()));
+
+            this->_output.pop_front();
+        }
+
+        this->_output_offset = remaining;
+        this->_output_size.fetch_sub(len);
+    }
+
+    size_t tcp_server::connection::_fill() {
+#if TLS
+        if (this->_tls) {
+            if (this->_handshaking && !this->_parent->_handshake(this))
+                throw mysocket::error(ECONNRESET, "TLS handshake failed");
+
+            char*   tail = this->_input.prepare(INPUT_BUFFER_SIZE);
+            ssize_t len;
+
+            while ((len = this->_recv(tail, this->_input.writable())) == -1 && errno == EINTR)
+                continue;
+
+            if (len == -1)
+                throw mysocket::error(errno);
+
+            this->_input.commit(len);
+
+            return len;
+        }
+#endif
+
+        return mysocket::_recv(this->_file_descriptor, this->_input);
+    }
+
+    void tcp_server::connection::_queue(const char* data, const size_t len) {
+        if (this->_output.empty() || !this->_output.back().block || buffer_pool::BUFFER_SIZE - this->_output.back().block_size < len)
+            this->_output.push_back({ "", nullptr, std::unique_ptr<char, output::release>(buffer_pool::acquire()) });
+
+        // Past what any send in flight covers, and blocks never move, so appending is safe
+        output& back = this->_output.back();
+
+        memcpy(back.block.get() + back.block_size, data, len);
+
+        back.block_size += len;
+    }
+
+    ssize_t tcp_server::connection::_recv(char* data, const size_t len) {
+        if (this->_transport)
+            return this->_transport->recv(data, len);
+
+#if TLS
+        if (this->_tls) {
+            int result = SSL_read(this->_tls, data, (int) std::min(len, (size_t) INT_MAX));
+
+            if (result > 0)
+                return result;
+
+            switch (SSL_get_error(this->_tls, result)) {
+                case SSL_ERROR_WANT_READ:
+                case SSL_ERROR_WANT_WRITE:
+                    errno = EAGAIN;
+
+                    return -1;
+                // close_notify
+                case SSL_ERROR_ZERO_RETURN:
+                    return 0;
+                case SSL_ERROR_SYSCALL:
+                    ERR_clear_error();
+
+                    return errno ? -1 : 0;
+                default:
+                    ERR_clear_error();
+
+                    errno = EPROTO;
+
+                    return -1;
+            }
+        }
+#endif
+
+        return ::recv(this->_file_descriptor, data, len, 0);
+    }
+
+    void tcp_server::connection::_reset(const int file_descriptor) {
+        this->_closed.store(false);
+        this->_closing = false;
+        this->_congested.store(false);
+        this->_file_descriptor = file_descriptor;
+#if TLS
+        this->_handshaking = false;
+        this->_tls_offloaded = false;
+#endif
+        this->_input.clear();
+        this->_input.shrink(INPUT_BUFFER_SIZE);
+        this->_loop = NULL;
+        this->_on_readable = nullptr;
+        this->_on_writable = nullptr;
+        this->_output.clear();
+        this->_output_offset = 0;
+        this->_output_size.store(0);
+        this->_pending = 0;
+        this->_reader = nullptr;
+        this->_sending = false;
+        this->_transport = nullptr;
+        this->_writer = nullptr;
+        this->_zerocopy = false;
+        this->_zerocopy_done = 0;
+        this->_zerocopy_held.clear();
+        this->_zerocopy_next = 0;
+        this->_zerocopy_ranges.clear();
+    }
+
+    void tcp_server::connection::_resume() {
+        // Cleared first; a resumed coroutine may well wait again
+        if (this->_reader && (this->_input.size() || this->_closed.load()))
+            std::exchange(this->_reader, nullptr).resume();
+
+        if (this->_writer && (this->_output.empty() || this->_closed.load()))
+            std::exchange(this->_writer, nullptr).resume();
+    }
+
+    ssize_t tcp_server::connection::_send(const struct msghdr* message, const int flags) {
+        if (this->_transport)
+            return this->_transport->send(message->msg_iov, message->msg_iovlen);
+
+#if TLS
+        if (this->_tls && !this->_tls_offloaded)
+            return this->_tls_send(message->msg_iov, message->msg_iovlen);
+#endif
+
+        return sendmsg(this->_file_descriptor, message, MSG_NOSIGNAL | MSG_DONTWAIT | flags);
+    }
+
+    void tcp_server::connection::_zerocopy_complete(const uint32_t first, const uint32_t last) {
+        // Usually in order; a range reported ahead of a gap waits for it to fill
+        if (first > this->_zerocopy_done)
+            this->_zerocopy_ranges[first] = last;
+        else
+            this->_zerocopy_done = std::max(this->_zerocopy_done, last + 1);
+
+        while (this->_zerocopy_ranges.size() && this->_zerocopy_ranges.begin()->first <= this->_zerocopy_done) {
+            this->_zerocopy_done = std::max(this->_zerocopy_done, this->_zerocopy_ranges.begin()->second + 1);
+            this->_zerocopy_ranges.erase(this->_zerocopy_ranges.begin());
+        }
+
+        while (this->_zerocopy_held.size() && this->_zerocopy_held.front().zerocopy_id < this->_zerocopy_done)
+            this->_zerocopy_held.pop_front();
+    }
+
+    void tcp_server::connection::_tls_close() {
+#if TLS
+        if (this->_tls == NULL)
+            return;
+
+        // The socket closes next either way
+        if (!this->_handshaking)
+            SSL_shutdown(this->_tls);
+
+        SSL_free(this->_tls);
+        ERR_clear_error();
+
+        this->_tls = NULL;
+#endif
+    }
+
+    void tcp_server::connection::_transport_close() {
+        if (this->_transport == nullptr)
+            return;
+
+        // Waits out a callback in flight; none can reach this use of the connection afterwards
+        this->_transport->on_ready(nullptr);
+        this->_transport->close();
+        this->_transport = nullptr;
+    }
+
+#if TLS
+    ssize_t tcp_server::connection::_tls_send(const struct iovec* iov, const size_t count) {
+        size_t total = 0;
+
+        for (size_t i = 0; i < count; ) {
+            const char* data = (const char *)iov[i].iov_base;
+            size_t      len = iov[i].iov_len,
+                        next = i + 1;
+
+            // A record each would cost a header, a MAC and an encryption call per small buffer. Joined the same way
+            // on retry, from the same offset, so a write OpenSSL asked to repeat is repeated
+            if (len < TLS_RECORD_SIZE && next < count && len + iov[next].iov_len <= TLS_RECORD_SIZE) {
+                this->_tls_record.append(data, len);
+
+                for (; next < count && this->_tls_record.size() + iov[next].iov_len <= TLS_RECORD_SIZE; next++)
+                    this->_tls_record.append((const char *)iov[next].iov_base, iov[next].iov_len);
+
+                data = this->_tls_record.data();
+                len = this->_tls_record.size();
+            }
+
+            int result = SSL_write(this->_tls, data, (int) std::min(len, (size_t) INT_MAX));
+
+            // Encrypted into OpenSSL's own record buffer, or joined again on retry; the block goes back to the pool
+            this->_tls_record.clear();
+            this->_tls_record.shrink(0);
+
+            if (result <= 0) {
+                int error = SSL_get_error(this->_tls, result);
+
+                ERR_clear_error();
+
+                if (total)
+                    return total;
+
+                errno = error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE ? EAGAIN : (error == SSL_ERROR_SYSCALL && errno ? errno : EPIPE);
+
+                return -1;
+            }
+
+            total += result;
+
+            // Partial; the rest goes with the next call
+            if ((size_t) result < len)
+                return total;
+
+            i = next;
+        }
+
+        return total;
+    }
+
+    int tcp_server::connection::_tls_write(struct iovec* iov, size_t count) {
+        if (this->_handshaking && !this->_parent->_handshake(this))
+            throw mysocket::error(ECONNRESET, "TLS handshake failed");
+
+        // The kernel encrypts from here on
+        if (this->_tls_offloaded)
+            return mysocket::_send(this->_file_descriptor, iov, count);
+
+        size_t total = 0;
+
+        while (count) {
+            ssize_t len = this->_tls_send(iov, count);
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                throw mysocket::error(errno);
+            }
+
+            total += len;
+
+            // Skip what was written, resuming mid-buffer after a short write
+            for (; count && (size_t) len >= iov->iov_len; iov++, count--)
+                len -= iov->iov_len;
+
+            if (count) {
+                iov->iov_base = (char *)iov->iov_base + len;
+                iov->iov_len -= len;
+            }
+        }
+
+        return (int) total;
+    }
+#endif
+
+    tcp_server::connection_table::slot* tcp_server::connection_table::_slot(const uint32_t index) const {
+        slot* chunk = this->_chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+
+        return chunk ? &chunk[index % CHUNK_SIZE] : NULL;
+    }
+
+    tcp_server::connection* tcp_server::connection_table::acquire(tcp_server* parent) {
+        uint64_t head = this->_free.load(std::memory_order_acquire);
+        uint32_t index;
+
+        while (true) {
+            // Pool empty; take a fresh slot
+            if ((uint32_t) head == 0) {
+                index = this->_size.fetch_add(1);
+
+                if (index >= CHUNK_SIZE * MAX_CHUNKS)
+                    throw mysocket::error(EMFILE);
+
+                std::atomic<slot*>& chunk = this->_chunks[index / CHUNK_SIZE];
+
+                if (chunk.load(std::memory_order_acquire) == NULL) {
+                    slot* temp = new slot[CHUNK_SIZE];
+                    slot* expected = NULL;
+
+                    // Another thread got there first
+                    if (!chunk.compare_exchange_strong(expected, temp, std::memory_order_acq_rel))
+                        delete[] temp;
+                }
+
+                break;
+            }
+
+            index = (uint32_t) head - 1;
+
+            // The tag makes a head that was popped and pushed back in between fail the exchange
+            uint64_t next = ((head >> 32) + 1) << 32 | this->_slot(index)->next.load(std::memory_order_relaxed);
+
+            if (this->_free.compare_exchange_weak(head, next, std::memory_order_acquire))
+                break;
+        }
+
+        slot* slot = this->_slot(index);
+
+        if (slot->connection == NULL) {
+            slot->connection = new class connection(parent);
+            slot->connection->_index = index;
+        }
+
+        return slot->connection;
+    }
+
+    std::vector<tcp_server::connection*> tcp_server::connection_table::connections() const {
+        std::vector<class connection*> result;
+        uint32_t                       size = (uint32_t) std::min((size_t) this->_size.load(), CHUNK_SIZE * MAX_CHUNKS);
+
+        for (uint32_t i = 0; i < size; i++) {
+            slot* slot = this->_slot(i);
+
+            if (slot && slot->generation.load(std::memory_order_acquire) & 1)
+                result.push_back(slot->connection);
+        }
+
+        return result;
+    }
+
+    tcp_server::connection* tcp_server::connection_table::find(const uint64_t id) const {
+        uint32_t generation = (uint32_t) (id >> 32);
+        uint32_t index = (uint32_t) id & ((1U << CONNECTION_INDEX_BITS) - 1);
+
+        if (!(generation & 1) || (uint32_t) id >> CONNECTION_INDEX_BITS != this->_tag || index >= std::min((size_t) this->_size.load(), CHUNK_SIZE * MAX_CHUNKS))
+            return NULL;
+
+        slot* slot = this->_slot(index);
+
+        if (slot == NULL || slot->generation.load(std::memory_order_acquire) != generation)
+            return NULL;
+
+        return slot->connection;
+    }
+
+    void tcp_server::connection_table::insert(class connection* connection) {
+        slot*    slot = this->_slot(connection->_index);
+        uint32_t generation = slot->generation.load(std::memory_order_relaxed) + 1;
+
+        connection->_id.store((uint64_t) generation << 32 | this->_tag << CONNECTION_INDEX_BITS | connection->_index);
+
+        // Publish only once the connection is set up
+        slot->generation.store(generation, std::memory_order_release);
+
+        this->_count.fetch_add(1);
+    }
+
+    void tcp_server::connection_table::release(class connection* connection) {
+        connection->_context = nullptr;
+
+        slot*    slot = this->_slot(connection->_index);
+        uint64_t head = this->_free.load(std::memory_order_relaxed);
+        uint64_t next;
+
+        do {
+            slot->next.store((uint32_t) head, std::memory_order_relaxed);
+
+            next = ((head >> 32) + 1) << 32 | (connection->_index + 1);
+        } while (!this->_free.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    tcp_server::connection* tcp_server::connection_table::remove(const uint64_t id) {
+        uint32_t generation = (uint32_t) (id >> 32);
+        uint32_t index = (uint32_t) id & ((1U << CONNECTION_INDEX_BITS) - 1);
+
+        if (!(generation & 1) || (uint32_t) id >> CONNECTION_INDEX_BITS != this->_tag || index >= std::min((size_t) this->_size.load(), CHUNK_SIZE * MAX_CHUNKS))
+            return NULL;
+
+        slot* slot = this->_slot(index);
+
+        // Only the first remover gets past this
+        if (slot == NULL || !slot->generation.compare_exchange_strong(generation, generation + 1, std::memory_order_acq_rel))
+            return NULL;
+
+        this->_count.fetch_sub(1);
+
+        return slot->connection;
+    }
+
+    size_t tcp_server::connection_table::size() const {
+        return this->_count.load();
+    }
+
+    void tcp_server::_inet(const int port) {
+        struct sockaddr_in* address = (struct sockaddr_in *)&this->_address;
+
+        memset(&this->_address, 0, sizeof(this->_address));
+
+        // Listen for any IP address
+        address->sin_addr.s_addr = INADDR_ANY;
+
+        // IPv4
+        address->sin_family = AF_INET;
+
+        // Convert port to network byte order
+        address->sin_port = htons(port);
+
+        this->_address_length = sizeof(struct sockaddr_in);
+    }
+
+    int tcp_server::_listen() {
+        int file_descriptor = ::socket(this->_address.ss_family, SOCK_STREAM, 0);
+            
+        if (file_descriptor == -1)
+            throw mysocket::error(errno);
+                
+        int opt = 1;
+        
+        if (this->_address.ss_family == AF_INET && (setsockopt(file_descriptor, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+            (this->_options.listeners != 1 && setsockopt(file_descriptor, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))))) {
+            ::close(file_descriptor);
+            
+            throw mysocket::error(errno);
+        }
+
+        if (this->_tune(file_descriptor)) {
+            int errnum = errno;
+
+            ::close(file_descriptor);
+
+            throw mysocket::error(errnum);
+        }
+
+        int status = bind(file_descriptor, (struct sockaddr *)&this->_address, this->_address_length);
+
+        // A socket file left behind by a server that is gone: nothing accepts on it, so take it over
+        if (status && errno == EADDRINUSE && this->_address.ss_family == AF_UNIX) {
+            const char* path = ((struct sockaddr_un *)&this->_address)->sun_path;
+            int         probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+            if (path[0] && probe != -1 && connect(probe, (struct sockaddr *)&this->_address, this->_address_length) && errno == ECONNREFUSED) {
+                unlink(path);
+
+                status = bind(file_descriptor, (struct sockaddr *)&this->_address, this->_address_length);
+            } else
+                errno = EADDRINUSE;
+
+            if (probe != -1)
+                ::close(probe);
+        }
+        
+        if (status) {
+            int errnum = errno;
+
+            ::close(file_descriptor);
+            
+            throw mysocket::error(errnum);
+        }
+        
+        if (::listen(file_descriptor, this->_options.backlog)) {
+            ::close(file_descriptor);
+            
+            throw mysocket::error(errno);
+        }
+
+        return file_descriptor;
+    }
+
+    void tcp_server::_modify(class connection* connection, const int events) {
+        if (connection->_transport == nullptr)
+            connection->_loop->modify(&connection->_watcher, events);
+    }
+
+    tcp_server::connection* tcp_server::_open(const int file_descriptor, shard* shard, event_loop* loop) {
+        class connection* connection;
+
+        try {
+            connection = shard->_connections->acquire(this);
+        } catch (mysocket::error& e) {
+            ::close(file_descriptor);
+
+            throw e;
+        }
+
+#if defined(TCP_QUICKACK)
+        int opt = 1;
+
+        // Not inherited from the listener; best effort, as the peer may already be gone
+        if (this->_options.quickack && this->_address.ss_family == AF_INET)
+            setsockopt(file_descriptor, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt));
+#endif
+
+        connection->_reset(file_descriptor);
+        connection->_loop = loop;
+
+#if TLS
+        if (this->_options.tls) {
+            connection->_tls = this->_options.tls->_accept(file_descriptor);
+
+            if (connection->_tls == NULL) {
+                shard->_connections->release(connection);
+
+                ::close(file_descriptor);
+
+                throw mysocket::error(ENOMEM);
+            }
+
+            connection->_handshaking = true;
+        }
+#endif
+
+        // OpenSSL copies into its records anyway
+#if TLS
+        connection->_zerocopy = this->_options.zerocopy_threshold && this->_options.mode != THREADED && connection->_tls == NULL;
+#else
+        connection->_zerocopy = this->_options.zerocopy_threshold && this->_options.mode != THREADED;
+#endif
+
+        shard->_connections->insert(connection);
+
+        return connection;
+    }
+
+    void tcp_server::_reap(class connection* connection) {
+#ifdef __linux__
+        if (connection->_closed.load() || connection->_zerocopy_next == 0)
+            return;
+
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+        while (true) {
+            struct msghdr message;
+
+            memset(&message, 0, sizeof(message));
+
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            if (recvmsg(connection->_file_descriptor, &message, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                break;
+            }
+
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                    continue;
+
+                struct sock_extended_err error;
+
+                memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+
+                if (error.ee_errno != 0 || error.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+
+                // Coalesced: ids ee_info through ee_data
+                this->_zerocopy_completions.fetch_add(error.ee_data - error.ee_info + 1);
+
+                // Copied after all, e.g. over loopback; pinning only costs from here on
+                if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                    connection->_zerocopy = false;
+
+                    this->_zerocopy_copied.fetch_add(1);
+                }
+
+                connection->_zerocopy_complete(error.ee_info, error.ee_data);
+            }
+        }
+
+        this->_drained(connection);
+#endif
+    }
+
+    void tcp_server::_read(class connection* connection) {
+        if (connection->_closed.load())
+            return;
+
+        bool eof = false;
+        bool received = false;
+
+        // Edge-triggered; read straight into the input buffer until the socket would block
+        while (true) {
+            char*   tail = connection->_input.prepare(INPUT_BUFFER_SIZE);
+            ssize_t len = connection->_recv(tail, connection->_input.writable());
+
+            if (len > 0) {
+                connection->_input.commit(len);
+
+                received = true;
+
+                continue;
+            }
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+            }
+
+            // Closed by peer or failed
+            eof = true;
+
+            break;
+        }
+
+        if (received) {
+            if (this->_options.idle_timeout)
+                connection->_loop->timers().add(&connection->_idle, this->_options.idle_timeout);
+
+            this->_readable(connection);
+            connection->_resume();
+        }
+
+        // Give back what a large request grew
+        connection->_input.shrink(INPUT_BUFFER_SIZE);
+
+        if (eof)
+            this->close(connection);
+    }
+
+    void tcp_server::_readable(class connection* connection) {
+        if (connection->_closing)
+            return;
+
+        if (this->_static_readable)
+            return this->_static_readable(this, connection);
+
+        if (connection->_on_readable)
+            connection->_on_readable(connection);
+    }
+
+    void tcp_server::_reject(const int file_descriptor) {
+        // A new connection's send buffer has room for a short response
+        if (this->_options.reject_message.length())
+            ::send(file_descriptor, this->_options.reject_message.data(), this->_options.reject_message.length(), MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        shutdown(file_descriptor, SHUT_WR);
+
+        char buff[1024];
+
+        // Discard what the peer already sent, so the close ends with a FIN rather than a reset that could destroy the response
+        while (::recv(file_descriptor, buff, sizeof(buff), MSG_DONTWAIT) > 0)
+            continue;
+
+        ::close(file_descriptor);
+    }
+
+    bool tcp_server::_shed(const int file_descriptor) {
+        std::lock_guard<std::mutex> lock(this->_reserve_mutex);
+
+        if (this->_reserve_file_descriptor != -1)
+            ::close(this->_reserve_file_descriptor);
+
+        // Non-blocking, like every listener: the pending connection may have gone, or been taken by another thread
+        int accepted = accept(file_descriptor, NULL, NULL);
+
+        if (accepted != -1)
+            this->_reject(accepted);
+
+        this->_reserve_file_descriptor = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        return accepted != -1;
+    }
+
+    std::function<void(tcp_server::connection*)> tcp_server::_spawn(const std::function<task<>(connection*)> handler) {
+        return [handler](class connection* connection) {
+            // Runs to its first await; it frees itself once done
+            handler(connection).detach();
+        };
+    }
+
+    void tcp_server::_start(const std::function<void(connection*)> handler, const struct options options) {
+        this->_handler = handler;
+        this->_options = options;
+        // Adopted, but served by this process alone
+        this->_adopted = this->_adopted && options.shared_listeners;
+        this->_reserve_file_descriptor = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        // A path binds once; there is no SO_REUSEPORT group to spread it over
+        if (this->_address.ss_family == AF_UNIX)
+            this->_options.listeners = 1;
+
+        // Bound to nothing, so serving transports alone: nothing to accept, which leaves nothing for a ring to do
+        if (this->_address.ss_family == AF_UNSPEC)
+            this->_options.mode = EVENT_LOOP;
+
+        if (this->_options.thread_per_core && (this->_options.mode == THREADED || this->_address.ss_family != AF_INET))
+            this->_options.thread_per_core = false;
+
+        if (this->_options.thread_per_core) {
+            std::vector<int> cpus = _allowed_cpus();
+            size_t           ncores = std::min(this->_options.threads ? this->_options.threads : cpus.size(), MAX_CORES);
+
+            // Steering sends a connection to listener (CPU % cores); pin each core where that lands it, so it is
+            // accepted, handled and answered on the CPU that took its packets
+            this->_cpus.assign(ncores, -1);
+
+            std::vector<int> rest;
+
+            for (int cpu: cpus) {
+                if (this->_cpus[cpu % ncores] == -1)
+                    this->_cpus[cpu % ncores] = cpu;
+                else
+                    rest.push_back(cpu);
+            }
+
+            for (size_t i = 0, j = 0; i < ncores; i++)
+                if (this->_cpus[i] == -1)
+                    this->_cpus[i] = rest.size() ? rest[j++ % rest.size()] : cpus[i % cpus.size()];
+
+            this->_options.incoming_cpu = true;
+            this->_options.listeners = ncores;
+            this->_options.steering = true;
+            this->_options.threads = ncores;
+        }
+
+        // Adopted listeners are already bound, and a server of transports alone binds none
+        size_t nlisteners = this->_shards.size() || this->_address.ss_family == AF_UNSPEC ? 0 : this->_options.listeners ? this->_options.listeners : std::max(std::thread::hardware_concurrency(), 1U);
+
+        for (size_t i = 0; i < nlisteners; i++) {
+            try {
+                this->_shards.push_back(new shard(this->_listen()));
+            } catch (mysocket::error& e) {
+                for (shard* shard: this->_shards) {
+                    ::close(shard->_file_descriptor);
+
+                    delete shard;
+                }
+
+                throw e;
+            }
+        }
+
+        if (this->_shards.size() > 1 && this->_options.steering)
+            this->_steer();
+
+#if defined(SO_INCOMING_CPU)
+        if (this->_options.incoming_cpu) {
+            size_t ncpus = std::max(std::thread::hardware_concurrency(), 1U);
+
+            // Best effort, like steering
+            for (size_t i = 0; i < this->_shards.size(); i++) {
+                int cpu = this->_cpus.size() ? this->_cpus[i % this->_cpus.size()] : i % ncpus;
+
+                setsockopt(this->_shards[i]->_file_descriptor, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+            }
+        }
+#endif
+
+#if defined(SO_ZEROCOPY)
+        int zerocopy = 1;
+
+        // Inherited by accepted sockets. Fails over AF_UNIX, and before Linux 4.14; messages are then copied as before
+        for (size_t i = 0; i < this->_shards.size() && this->_options.zerocopy_threshold; i++)
+            if (setsockopt(this->_shards[i]->_file_descriptor, SOL_SOCKET, SO_ZEROCOPY, &zerocopy, sizeof(zerocopy)))
+                this->_options.zerocopy_threshold = 0;
+#else
+        this->_options.zerocopy_threshold = 0;
+#endif
+
+#if TLS
+        // OpenSSL reads and writes the socket itself, which leaves nothing for the ring to do
+        if (this->_options.tls && this->_options.mode == IO_URING)
+            this->_options.mode = EVENT_LOOP;
+#endif
+
+#ifdef __linux__
+        if (this->_options.mode == IO_URING && !uring::supported())
+            this->_options.mode = EVENT_LOOP;
+#else
+        this->_options.mode = this->_options.mode == IO_URING ? EVENT_LOOP : this->_options.mode;
+#endif
+
+        // One accept loop per listener, unless the ring pairs them up otherwise
+        this->_accepting.store(this->_shards.size());
+
+        // Shared-nothing: each core admits, finds and frees its connections in its own table
+        for (size_t i = 0; i < (this->_options.thread_per_core ? std::min(this->_shards.size(), MAX_CORES) : 1); i++)
+            this->_tables.push_back(new connection_table((uint32_t) i));
+
+        for (size_t i = 0; i < this->_shards.size(); i++)
+            this->_shards[i]->_connections = this->_tables[i % this->_tables.size()];
+
+        if (this->_options.mode != THREADED) {
+            size_t nthreads = this->_options.threads ? this->_options.threads : std::max(std::thread::hardware_concurrency(), 1U);
+
+            for (size_t i = 0; i < nthreads; i++)
+                this->_loops.push_back(new event_loop(this->_options.mode == IO_URING));
+
+            for (size_t i = 0; i < this->_shards.size(); i++) {
+                set_nonblocking(this->_shards[i]->_file_descriptor);
+
+                // Sharded: keep each connection on the loop of the listener that accepted it
+                if (this->_shards.size() > 1)
+                    this->_shards[i]->_loop = this->_loops[i % nthreads];
+            }
+
+#ifdef __linux__
+            if (this->_options.mode == IO_URING) {
+                // Pair every loop with a listener, and every listener with a loop
+                this->_accept_operations.resize(std::max(nthreads, this->_shards.size()));
+                this->_accepting.store(this->_accept_operations.size());
+                this->_accept_polls.resize(this->_accept_operations.size());
+
+                for (size_t i = 0; i < this->_accept_operations.size(); i++) {
+                    shard*      shard = this->_shards[i % this->_shards.size()];
+                    event_loop* loop = this->_loops[i % nthreads];
+
+                    this->_accept_operations[i] = event_loop::operation([this, i, shard, loop](const int result, const unsigned flags) {
+                        // Fails before looking for a pending connection, so with none pending, wait for one rather than spin
+                        if ((result == -EMFILE || result == -ENFILE) && !this->_shed(shard->_file_descriptor))
+                            return this->_draining.load() ? this->_accept_stopped() : loop->ring()->prep_poll(shard->_file_descriptor, POLLIN, &this->_accept_polls[i]);
+
+                        // Adopted: accepted from a queue other processes share, before the cancel landed; serve it
+                        if (result >= 0 && this->_draining.load() && !this->_adopted)
+                            ::close(result);
+                        else if (result >= 0 && this->_admit(result, shard)) {
+                            class connection* connection = NULL;
+
+                            try {
+                                connection = this->_open(result, shard, loop);
+                            } catch (mysocket::error& e) { }
+
+                            if (connection)
+                                this->_arm(connection);
+
+                            if (connection && !this->_shut_down.load())
+                                this->_handler(connection);
+
+                            if (connection && !connection->_closed.load())
+                                this->_uring_recv(connection);
+                        } else if (result == -EINVAL && this->_multishot.load())
+                            // Kernel predates multishot accept; re-arm once per connection
+                            this->_multishot.store(false);
+
+                        if (flags & IORING_CQE_F_MORE || this->_shut_down.load())
+                            return;
+
+                        if (this->_draining.load())
+                            this->_accept_stopped();
+                        else
+                            this->_uring_accept(i);
+                    });
+
+                    this->_accept_polls[i] = event_loop::operation([this, i](const int, const unsigned) {
+                        if (this->_shut_down.load())
+                            return;
+
+                        if (this->_draining.load())
+                            this->_accept_stopped();
+                        else
+                            this->_uring_accept(i);
+                    });
+
+                    this->_uring_accept(i);
+                }
+            } else {
+#endif
+                for (size_t i = 0; i < this->_shards.size(); i++) {
+                    shard* shard = this->_shards[i];
+
+                    shard->_listener_watcher = event_loop::watcher(shard->_file_descriptor, [this, shard](const int) {
+                        this->_accept(shard);
+                    });
+
+                    this->_loops[i % nthreads]->add(&shard->_listener_watcher, event_loop::READABLE);
+                }
+#ifdef __linux__
+            }
+#endif
+
+            for (size_t i = 0; i < nthreads; i++)
+                this->_threads.push_back(std::thread([this, i, loop = this->_loops[i]]{
+                    if (this->_cpus.size())
+                        _pin(this->_cpus[i]);
+
+#ifdef __linux__
+                    // From the loop's own thread, so the pages are first touched, and placed, on its NUMA node
+                    if (this->_options.mode == IO_URING)
+                        loop->ring()->provide_buffers(URING_BUFFER_COUNT, URING_BUFFER_SIZE);
+#endif
+
+                    loop->run();
+                }));
+
+            return;
+        }
+        
+        // Waited on with poll(), so no accept() blocks: not the loop's, once another process takes the connection, nor
+        // _shed()'s, holding the reserve, once the peer has gone
+        for (size_t i = 0; i < this->_shards.size(); i++)
+            set_nonblocking(this->_shards[i]->_file_descriptor);
+
+        for (shard* shard: this->_shards)
+            shard->_listener = std::thread([this, shard]{
+                while (true) {
+                    if (this->_shut_down.load())
+                        return;
+
+                    // Leave the rest of a shared queue to the other processes
+                    if (this->_adopted && this->_draining.load())
+                        return this->_accept_stopped();
+
+                    struct pollfd pollfd = { shard->_file_descriptor, POLLIN, 0 };
+
+                    // Adopted listeners are never shut down to wake it, so drain() is checked for between timeouts
+                    if (poll(&pollfd, 1, this->_adopted ? ADOPTED_POLL_TIMEOUT : -1) <= 0)
+                        continue;
+                    
+                    // Returns nonnegative file descriptor or -1 for error
+#ifdef __linux__
+                    int file_descriptor = accept4(shard->_file_descriptor, NULL, NULL, SOCK_CLOEXEC);
+#else
+                    int file_descriptor = accept(shard->_file_descriptor, NULL, NULL);
+
+                    // Inherited from the non-blocking listener
+                    if (file_descriptor != -1)
+                        fcntl(file_descriptor, F_SETFL, fcntl(file_descriptor, F_GETFL) & ~O_NONBLOCK);
+#endif
+                    
+                    if (file_descriptor == -1) {
+                        int errnum = errno;
+
+                        if (errnum == EMFILE || errnum == ENFILE)
+                            this->_shed(shard->_file_descriptor);
+
+                        // Shut down by drain() or close()
+                        if (errnum == EINVAL && (this->_draining.load() || this->_shut_down.load()))
+                            return;
+
+                        continue;
+                    }
+
+                    // Adopted: taken off a queue other processes share, just as drain() began; serve it
+                    if (this->_draining.load() && !this->_adopted) {
+                        ::close(file_descriptor);
+
+                        continue;
+                    }
+
+                    if (!this->_admit(file_descriptor, shard))
+                        continue;
+
+                    class connection* connection;
+
+                    try {
+                        connection = this->_open(file_descriptor, shard, NULL);
+                    } catch (mysocket::error& e) {
+                        continue;
+                    }
+
+                    this->_handler(connection);
+                }
+            });
+    }
+
+    void tcp_server::_steer() {
+#ifdef __linux__
+        // Index of the listener = receiving CPU modulo the number of listeners (in bind order)
+        struct sock_filter code[] = {
+            { BPF_LD | BPF_W | BPF_ABS, 0, 0, (__u32)(SKF_AD_OFF + SKF_AD_CPU) },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (__u32)this->_shards.size() },
+            { BPF_RET | BPF_A, 0, 0, 0 }
+        };
+        struct sock_fprog  program = { sizeof(code) / sizeof(code[0]), code };
+
+        // Best effort; without it the kernel hashes connections over the listeners
+        setsockopt(this->_shards[0]->_file_descriptor, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program));
+#endif
+    }
+
+    tcp_server::connection_table* tcp_server::_table(const uint64_t id) const {
+        uint32_t tag = (uint32_t) id >> CONNECTION_INDEX_BITS;
+
+        return tag < this->_tables.size() ? this->_tables[tag] : NULL;
+    }
+
+    int tcp_server::_tune(const int file_descriptor) const {
+        const struct options& options = this->_options;
+        int                   opt = 1;
+
+        if ((options.receive_buffer && setsockopt(file_descriptor, SOL_SOCKET, SO_RCVBUF, &options.receive_buffer, sizeof(options.receive_buffer))) ||
+            (options.send_buffer && setsockopt(file_descriptor, SOL_SOCKET, SO_SNDBUF, &options.send_buffer, sizeof(options.send_buffer))))
+            return -1;
+
+#if defined(SO_BUSY_POLL)
+        if (options.busy_poll && setsockopt(file_descriptor, SOL_SOCKET, SO_BUSY_POLL, &options.busy_poll, sizeof(options.busy_poll)))
+            return -1;
+#endif
+
+        // The rest is TCP
+        if (this->_address.ss_family != AF_INET)
+            return 0;
+
+        if (options.nodelay && setsockopt(file_descriptor, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)))
+            return -1;
+
+#if defined(TCP_FASTOPEN)
+        if (options.fastopen && setsockopt(file_descriptor, IPPROTO_TCP, TCP_FASTOPEN, &options.fastopen, sizeof(options.fastopen)))
+            return -1;
+#endif
+
+#if defined(TCP_DEFER_ACCEPT)
+        if (options.defer_accept && setsockopt(file_descriptor, IPPROTO_TCP, TCP_DEFER_ACCEPT, &options.defer_accept, sizeof(options.defer_accept)))
+            return -1;
+#endif
+
+        return 0;
+    }
+
+    void tcp_server::_unix(const std::string path) {
+        memset(&this->_address, 0, sizeof(this->_address));
+
+        this->_address_length = _unix_address(path, (struct sockaddr_un *)&this->_address);
+    }
+
+    void tcp_server::_unlisten() {
+#ifdef __linux__
+        for (size_t i = 0; i < this->_accept_operations.size(); i++) {
+            event_loop* loop = this->_loops[i % this->_loops.size()];
+
+            loop->post([this, i, loop]() {
+                loop->ring()->prep_cancel(&this->_accept_operations[i]);
+                loop->ring()->prep_cancel(&this->_accept_polls[i]);
+            });
+        }
+#endif
+
+        if (this->_options.mode != EVENT_LOOP)
+            return;
+
+        for (size_t i = 0; i < this->_shards.size(); i++) {
+            shard* shard = this->_shards[i];
+
+            this->_loops[i % this->_loops.size()]->post([this, shard, i]() {
+                this->_loops[i % this->_loops.size()]->remove(&shard->_listener_watcher);
+                this->_accept_stopped();
+            });
+        }
+    }
+
+    void tcp_server::_uring_accept(const size_t index) {
+#ifdef __linux__
+        shard* shard = this->_shards[index % this->_shards.size()];
+
+        this->_loops[index % this->_loops.size()]->ring()->prep_accept(shard->_file_descriptor, this->_multishot.load(), &this->_accept_operations[index]);
+#endif
+    }
+
+    void tcp_server::_uring_recv(class connection* connection) {
+#ifdef __linux__
+        if (connection->_recv_operation.callback == nullptr)
+            connection->_recv_operation = event_loop::operation([this, connection](const int result, const unsigned flags) {
+                connection->_pending--;
+
+                uring* ring = connection->_loop->ring();
+
+                if (result > 0) {
+                    unsigned short id = flags >> IORING_CQE_BUFFER_SHIFT;
+
+                    connection->_input.append(ring->buffer(id), result);
+
+                    // Hand the buffer straight back; it is resubmitted with the next batch
+                    ring->release_buffer(id);
+                }
+
+                if (connection->_closed.load())
+                    return this->_uring_release(connection);
+
+                if (result > 0) {
+                    if (this->_options.idle_timeout)
+                        connection->_loop->timers().add(&connection->_idle, this->_options.idle_timeout);
+
+                    this->_readable(connection);
+
+                    connection->_resume();
+                    connection->_input.shrink(INPUT_BUFFER_SIZE);
+
+                    if (!connection->_closed.load())
+                        this->_uring_recv(connection);
+
+                    return;
+                }
+
+                // Every provided buffer is in use; retry once the loop has drained
+                if (result == -ENOBUFS) {
+                    connection->_pending++;
+
+                    return connection->_loop->post([this, connection]() {
+                        connection->_pending--;
+
+                        if (connection->_closed.load())
+                            return this->_uring_release(connection);
+
+                        this->_uring_recv(connection);
+                    });
+                }
+
+                // Closed by peer or failed
+                this->close(connection);
+            });
+
+        connection->_pending++;
+        connection->_loop->ring()->prep_recv(connection->_file_descriptor, &connection->_recv_operation);
+#endif
+    }
+
+    void tcp_server::_uring_release(class connection* connection) {
+        // Back to the pool once closed and the kernel holds no operation on it; whatever is left at shutdown goes with the table
+        if (connection->_file_descriptor == -1 && connection->_pending == 0 && this->_threads.size())
+            this->_table(connection->id())->release(connection);
+    }
+
+    void tcp_server::_uring_send(class connection* connection) {
+#ifdef __linux__
+        if (connection->_send_operation.callback == nullptr)
+            connection->_send_operation = event_loop::operation([this, connection](const int result, const unsigned) {
+                connection->_pending--;
+                connection->_sending = false;
+
+                if (connection->_closed.load())
+                    return this->_uring_release(connection);
+
+                if (result < 0)
+                    return this->close(connection);
+
+                connection->_consume(result);
+
+                if (connection->_output.size())
+                    this->_uring_send(connection);
+
+                this->_drained(connection);
+            });
+
+        // Everything queued since the last send goes out in one operation, bar messages sent in place
+        size_t offset = connection->_output_offset,
+               threshold = connection->_zerocopy && this->_send_zc.load() ? this->_options.zerocopy_threshold : SIZE_MAX;
+
+        connection->_output_iov.clear();
+
+        for (size_t i = 0; i < connection->_output.size() && connection->_output_iov.size() < IOV_MAX; i++) {
+            std::string_view message = connection->_output[i].view();
+
+            if (i && message.length() >= threshold)
+                break;
+
+            connection->_output_iov.push_back({ (char *)message.data() + offset, message.length() - offset });
+
+            offset = 0;
+        }
+
+        connection->_pending++;
+        connection->_sending = true;
+
+        uring* ring = connection->_loop->ring();
+
+        if (connection->_output_iov[0].iov_len >= threshold) {
+            uint32_t               id = connection->_zerocopy_next++;
+            // One per send, as the notification names only the operation it belongs to
+            event_loop::operation* operation = new event_loop::operation();
+
+            operation->callback = [this, connection, operation, id](const int result, const unsigned flags) {
+                this->_uring_zerocopy(connection, operation, id, result, flags);
+            };
+
+            connection->_output.front().zerocopy = true;
+            connection->_output.front().zerocopy_id = id;
+
+            this->_zerocopy_sends.fetch_add(1);
+
+            return ring->prep_send_zc(
+                connection->_file_descriptor,
+                (const char *)connection->_output_iov[0].iov_base, connection->_output_iov[0].iov_len,
+                operation);
+        }
+
+        if (connection->_output_iov.size() == 1)
+            return ring->prep_send(
+                connection->_file_descriptor,
+                (const char *)connection->_output_iov[0].iov_base, connection->_output_iov[0].iov_len,
+                &connection->_send_operation);
+
+        memset(&connection->_output_message, 0, sizeof(connection->_output_message));
+
+        connection->_output_message.msg_iov = connection->_output_iov.data();
+        connection->_output_message.msg_iovlen = connection->_output_iov.size();
+
+        ring->prep_sendmsg(connection->_file_descriptor, &connection->_output_message, &connection->_send_operation);
+#endif
+    }
+
+    void tcp_server::_uring_zerocopy(class connection* connection, event_loop::operation* operation, const uint32_t id, const int result, const unsigned flags) {
+#ifdef __linux__
+        // Arguments, not captures; the operation goes first
+        if (flags & IORING_CQE_F_NOTIF) {
+            delete operation;
+
+            connection->_pending--;
+
+            this->_zerocopy_completions.fetch_add(1);
+
+            // Copied after all, e.g. over loopback; pinning only costs from here on
+            if (result & IORING_NOTIF_USAGE_ZC_COPIED) {
+                connection->_zerocopy = false;
+
+                this->_zerocopy_copied.fetch_add(1);
+            }
+
+            connection->_zerocopy_complete(id, id);
+
+            if (connection->_closed.load())
+                return this->_uring_release(connection);
+
+            return this->_drained(connection);
+        }
+
+        // No notification follows
+        if (!(flags & IORING_CQE_F_MORE)) {
+            delete operation;
+
+            connection->_zerocopy_complete(id, id);
+        }
+
+        // Kernel predates IORING_OP_SEND_ZC, or its usage reports; send it again, copied
+        if ((result == -EINVAL || result == -EOPNOTSUPP) && !(flags & IORING_CQE_F_MORE)) {
+            this->_send_zc.store(false);
+
+            connection->_output.front().zerocopy = false;
+            connection->_pending--;
+            connection->_sending = false;
+
+            if (connection->_closed.load())
+                return this->_uring_release(connection);
+
+            return this->_uring_send(connection);
+        }
+
+        // Held for the notification
+        if (flags & IORING_CQE_F_MORE)
+            connection->_pending++;
+
+        connection->_send_operation.callback(result, flags);
+#endif
+    }
+
+    void tcp_server::_watch(class connection* connection) {
+        connection->_watcher = event_loop::watcher(connection->_file_descriptor, [this, connection](int events) {
+#if TLS
+            if (connection->_handshaking) {
+                if (!this->_handshake(connection))
+                    return;
+
+                // Requests may have come in with the last flight, and responses queued meanwhile
+                events = event_loop::READABLE | event_loop::WRITABLE;
+            }
+#endif
+
+            if (events & event_loop::ERROR)
+                this->_reap(connection);
+
+            if (events & event_loop::WRITABLE)
+                this->_flush(connection);
+
+            if (events & event_loop::READABLE)
+                this->_read(connection);
+        });
+    }
+
+    void tcp_server::_write(class connection* connection) {
+        if (connection->_output.size() && !connection->_sending) {
+            if (this->_options.mode == IO_URING && connection->_transport == nullptr)
+                this->_uring_send(connection);
+            else
+                this->_flush(connection);
+        }
+
+        if (connection->_closed.load())
+            return;
+
+        size_t size = connection->_output_size.load();
+
+        // Measured after the write, so one large response to a fast reader passes
+        if (this->_options.max_output && size > this->_options.max_output)
+            return this->close(connection);
+
+        if (this->_options.high_watermark && size >= this->_options.high_watermark)
+            connection->_congested.store(true);
+    }
+
+    void udp_socket::_configure() {
+#ifdef __linux__
+        int       value = 1;
+        socklen_t len = sizeof(value);
+
+        // Before Linux 5.0; datagrams then arrive one by one
+        if (this->_options.gro && setsockopt(this->_file_descriptor, SOL_UDP, UDP_GRO, &value, sizeof(value)))
+            this->_options.gro = false;
+
+        // Before Linux 4.18; runs are then sent datagram by datagram
+        if (this->_options.gso_size && getsockopt(this->_file_descriptor, SOL_UDP, UDP_SEGMENT, &value, &len))
+            this->_options.gso_size = 0;
+#else
+        this->_options.gro = false;
+        this->_options.gso_size = 0;
+#endif
+    }
+
+    size_t udp_socket::_slot_size() const {
+        // Coalesced reads run up to a full IP packet of segments
+        return this->_options.gro ? std::max(this->_options.max_datagram_size, (size_t) USHRT_MAX) : this->_options.max_datagram_size;
+    }
+
+    tcp_server::connection::recv_awaiter tcp_server::connection::async_recv() {
+        return recv_awaiter { this };
+    }
+
+    tcp_server::connection::send_awaiter tcp_server::connection::async_send(std::vector<std::string> buffers) {
+        return send_awaiter { this, this->send(std::move(buffers)) };
+    }
+
+    bool tcp_server::connection::recv_awaiter::await_ready() {
+        // THREADED; no loop to wait on, so read in place
+        if (this->connection->_loop == NULL) {
+            if (this->connection->_input.size() == 0)
+                this->connection->_fill();
+
+            return true;
+        }
+
+        return this->connection->_input.size() || this->connection->_closed.load();
+    }
+
+    bool tcp_server::connection::send_awaiter::await_ready() {
+        return this->connection->_parent->_options.mode == THREADED || this->connection->_output.empty() || this->connection->_closed.load();
+    }
+
+    std::string tcp_server::connection::recv_awaiter::await_resume() {
+        std::string input = this->connection->_input.str();
+
+        this->connection->_input.clear();
+
+        return input;
+    }
+
+    int tcp_server::connection::send_awaiter::await_resume() {
+        return this->length;
+    }
+
+    void tcp_server::connection::recv_awaiter::await_suspend(std::coroutine_handle<> handle) {
+        this->connection->_reader = handle;
+    }
+
+    void tcp_server::connection::send_awaiter::await_suspend(std::coroutine_handle<> handle) {
+        this->connection->_writer = handle;
+    }
+
+    size_t tcp_server::connection::buffered() const {
+        return this->_output_size.load();
+    }
+
+    void tcp_server::connection::close() {
+        tcp_server* parent = this->_parent;
+
+        if (parent->_options.mode == THREADED || this->_closed.load())
+            return parent->close(this);
+
+        // The queue belongs to the loop
+        if (!this->_loop->is_current())
+            return this->_loop->post([parent, id = this->id()]() {
+                class connection* connection = parent->find(id);
+
+                if (connection)
+                    connection->close();
+            });
+
+        if (this->_output.empty() && this->_zerocopy_held.empty())
+            return parent->close(this);
+
+        if (this->_closing)
+            return;
+
+        // Linger until the queue drains, or the deadline passes
+        this->_closing = true;
+
+        this->_loop->timers().remove(&this->_idle);
+        this->_loop->timers().add(&this->_deadline, parent->_options.linger_timeout);
+    }
+
+    bool tcp_server::connection::congested() const {
+        return this->_congested.load();
+    }
+
+    void tcp_server::connection::context(const std::shared_ptr<void> value) {
+        this->_context = value;
+    }
+
+    void tcp_server::connection::cork(const bool value) {
+        if (this->_parent->_options.mode == IO_URING || this->_transport)
+            return;
+
+        int opt = value;
+
+        // Best effort; uncorking flushes whatever was held back
+#if defined(TCP_CORK)
+        setsockopt(this->_file_descriptor, IPPROTO_TCP, TCP_CORK, &opt, sizeof(opt));
+#elif defined(TCP_NOPUSH)
+        setsockopt(this->_file_descriptor, IPPROTO_TCP, TCP_NOPUSH, &opt, sizeof(opt));
+#endif
+    }
+
+    void tcp_client::close() {
+        if (::close(this->_file_descriptor)) 
+            throw mysocket::error(errno);
+
+        delete this;
+    }
+
+    void tcp_server::close() {
+        this->_shut_down.store(true);
+
+        if (this->_reserve_file_descriptor != -1)
+            ::close(this->_reserve_file_descriptor);
+
+        // New callers fail fast instead of queueing on a listener about to close
+        if (this->_address.ss_family == AF_UNIX && ((struct sockaddr_un *)&this->_address)->sun_path[0] && !this->_adopted)
+            unlink(((struct sockaddr_un *)&this->_address)->sun_path);
+
+        if (this->_options.mode != THREADED) {
+            for (event_loop* loop: this->_loops)
+                loop->stop();
+
+            for (std::thread& thread: this->_threads)
+                thread.join();
+
+            this->_threads.clear();
+
+            for (shard* shard: this->_shards)
+                ::close(shard->_file_descriptor);
+
+            std::vector<class connection*> connections;
+
+            for (class connection* connection: this->connections()) {
+                if (this->_table(connection->id())->remove(connection->id()) == NULL)
+                    continue;
+
+                connection->_closed.store(true);
+
+                // Before the loops go, so no readiness is posted to them
+                connection->_transport_close();
+
+                connections.push_back(connection);
+            }
+
+            // Run deferred closes before the remaining descriptors are closed
+            for (event_loop* loop: this->_loops)
+                loop->close();
+
+            for (class connection* connection: connections) {
+                connection->_resume();
+                connection->_tls_close();
+
+                ::close(connection->_file_descriptor);
+            }
+
+            for (shard* shard: this->_shards)
+                delete shard;
+
+            delete this;
+
+            return;
+        }
+
+        for (shard* shard: this->_shards) {
+            // Wakes the blocked accept(); an adopted listener's loop sees the shut down within a poll
+            if (this->_adopted)
+                shard->_listener.join();
+            else
+                shutdown(shard->_file_descriptor, SHUT_RDWR);
+
+            if (::close(shard->_file_descriptor))
+                throw mysocket::error(errno);
+
+            if (shard->_listener.joinable())
+                shard->_listener.join();
+
+            delete shard;
+        }
+
+        for (class connection* connection: this->connections()) {
+            if (this->_table(connection->id())->remove(connection->id()) == NULL)
+                continue;
+
+            connection->_closed.store(true);
+            connection->_tls_close();
+
+            if (::close(connection->_file_descriptor))
+                throw mysocket::error(errno);
+        }
+        
+        delete this;
+    }
+
+    void udp_socket::close() {
+        if (::close(this->_file_descriptor))
+            throw mysocket::error(errno);
+        
+        delete this->_address;
+        delete this;
+    }
+
+    void tcp_server::close(class connection* connection) {
+        this->close(connection->id());
+    }
+
+    void tcp_server::close(const uint64_t id) {
+        connection_table* table = this->_table(id);
+        class connection* connection = table ? table->remove(id) : NULL;
+
+        // Already closed
+        if (connection == NULL)
+            return;
+
+        connection->_closed.store(true);
+
+        if (this->_draining.load()) {
+            std::lock_guard<std::mutex> lock(this->_drain_mutex);
+
+            this->_drain_condition.notify_all();
+        }
+
+        if (this->_options.mode != THREADED)
+            // Close on the owning loop, after any callback in flight has returned, so the descriptor is never reused under it
+            return connection->_loop->post([this, connection, table]() {
+                connection->_loop->timers().remove(&connection->_deadline);
+                connection->_loop->timers().remove(&connection->_idle);
+
+                // Awaiting coroutines see the close before the connection can be reused
+                connection->_resume();
+                connection->_tls_close();
+
+                if (this->_options.mode == EVENT_LOOP || connection->_transport) {
+                    if (connection->_transport)
+                        connection->_transport_close();
+                    else
+                        ::close(connection->_file_descriptor);
+
+                    table->release(connection);
+
+                    return;
+                }
+
+                // Completes the receive in flight; the kernel holds its own reference to the socket
+                shutdown(connection->_file_descriptor, SHUT_RDWR);
+
+                ::close(connection->_file_descriptor);
+
+                connection->_file_descriptor = -1;
+
+                this->_uring_release(connection);
+            });
+
+        int file_descriptor = connection->_file_descriptor;
+
+        connection->_tls_close();
+
+        table->release(connection);
+
+        if (::close(file_descriptor))
+            throw mysocket::error(errno);
+    }
+
+    std::vector<tcp_server::connection*> tcp_server::connections() {
+        std::vector<class connection*> result;
+
+        for (connection_table* table: this->_tables) {
+            std::vector<class connection*> connections = table->connections();
+
+            result.insert(result.end(), connections.begin(), connections.end());
+        }
+
+        return result;
+    }
+
+    size_t tcp_server::cores() const {
+        return this->_loops.size();
+    }
+
+    void tcp_server::drain(const size_t timeout) {
+        this->_draining.store(true);
+
+        // Linux resets the queued handshakes and refuses new ones, so peers sharing the port take them; elsewhere the
+        // accept paths close what still arrives
+        for (size_t i = 0; i < this->_shards.size() && !this->_adopted; i++)
+            shutdown(this->_shards[i]->_file_descriptor, SHUT_RDWR);
+
+        // Adopted: other processes go on accepting from the same sockets, so just stop taking connections off them
+        if (this->_adopted)
+            this->_unlisten();
+
+        // Waiting on a deadline means no request is in flight; queued output still drains first
+        for (event_loop* loop: this->_loops)
+            loop->post([loop, this]() {
+                for (class connection* connection: this->connections())
+                    if (connection->_loop == loop && connection->_deadline.active())
+                        connection->close();
+            });
+
+        std::unique_lock<std::mutex> lock(this->_drain_mutex);
+
+        // Adopted: a connection taken off the shared queue just before its accept loop stopped is still served
+        this->_drain_condition.wait_for(lock, std::chrono::milliseconds(timeout), [this]() {
+            if (this->_adopted && this->_accepting.load())
+                return false;
+
+            for (connection_table* table: this->_tables)
+                if (table->size())
+                    return false;
+
+            return true;
+        });
+    }
+
+    bool tcp_server::draining() const {
+        return this->_draining.load();
+    }
+
+    int error::errnum() const {
+        return this->_errnum;
+    }
+
+    tcp_server::connection* tcp_server::find(const uint64_t id) const {
+        connection_table* table = this->_table(id);
+
+        return table ? table->find(id) : NULL;
+    }
+
+    std::vector<int> tcp_server::listen(const int port, const struct options options) {
+        tcp_server       server;
+        std::vector<int> result;
+
+        server._inet(port);
+        server._options = options;
+
+        size_t nlisteners = options.listeners ? options.listeners : std::max(std::thread::hardware_concurrency(), 1U);
+
+        for (size_t i = 0; i < nlisteners; i++) {
+            try {
+                result.push_back(server._listen());
+            } catch (mysocket::error& e) {
+                for (int file_descriptor: result)
+                    ::close(file_descriptor);
+
+                throw e;
+            }
+        }
+
+        return result;
+    }
+
+    struct credentials tcp_server::connection::credentials() const {
+        return _credentials(this->_file_descriptor);
+    }
+
+    struct credentials tcp_client::credentials() const {
+        return _credentials(this->_file_descriptor);
+    }
+
+    uint64_t tcp_server::connection::id() const {
+        return this->_id.load();
+    }
+
+    buffer& tcp_server::connection::input() {
+        return this->_input;
+    }
+
+    tcp_server::io_mode tcp_server::mode() const {
+        return this->_options.mode;
+    }
+
+    uint64_t tcp_server::open(std::shared_ptr<transport> transport) {
+        if (this->_options.mode == THREADED)
+            throw mysocket::error(ENOTSUP);
+
+        if (this->_draining.load() || this->_shut_down.load())
+            throw mysocket::error(ECONNREFUSED);
+
+        // Spread like accepted connections; in thread-per-core mode, loop i owns table i
+        size_t            i = this->_next_loop.fetch_add(1) % this->_loops.size();
+        connection_table* table = this->_tables[i % this->_tables.size()];
+        size_t            share = (this->_options.max_connections + this->_tables.size() - 1) / this->_tables.size();
+
+        if (this->_options.max_connections && table->size() >= share)
+            throw mysocket::error(ECONNREFUSED);
+
+        class connection* connection = table->acquire(this);
+
+        connection->_reset(-1);
+        connection->_loop = this->_loops[i];
+        connection->_transport = transport;
+
+        table->insert(connection);
+
+        this->_watch(connection);
+
+        connection->_loop->post([this, connection, id = connection->id()]() {
+            if (connection->_closed.load() || this->_shut_down.load())
+                return;
+
+            this->_arm(connection);
+
+            // Readiness comes back through the loop, like a socket's, and only while this use of the connection lasts
+            connection->_transport->on_ready([this, id](const int events) {
+                this->post(id, [events](class connection* connection) {
+                    connection->_watcher.callback(events);
+                });
+            });
+
+            this->_handler(connection);
+
+            // Whatever the peer sent before there was anyone to tell
+            this->_read(connection);
+        });
+
+        return connection->id();
+    }
+
+    void tcp_server::connection::on_readable(const std::function<void(connection*)> callback) {
+        this->_on_readable = callback;
+    }
+
+    void tcp_server::connection::on_writable(const std::function<void(connection*)> callback) {
+        this->_on_writable = callback;
+    }
+
+    void tcp_server::post(const uint64_t id, const std::function<void(connection*)> task) {
+        class connection* connection = this->find(id);
+
+        if (connection == NULL)
+            return;
+
+        if (connection->_loop == NULL)
+            return task(connection);
+
+        connection->_loop->post([this, id, task]() {
+            class connection* connection = this->find(id);
+
+            if (connection)
+                task(connection);
+        });
+    }
+
+    std::string tcp_server::connection::recv() {
+        if (this->_loop == NULL)
+            this->_fill();
+
+        std::string input = this->_input.str();
+
+        this->_input.clear();
+        this->_input.shrink(INPUT_BUFFER_SIZE);
+
+        return input;
+    }
+
+    std::string tcp_client::recv() const {
+        buffer buff;
+
+        _recv(this->_file_descriptor, buff);
+
+        return buff.str();
+    }
+
+    size_t tcp_client::recv(buffer& buff, const int timeout) const {
+        if (timeout >= 0) {
+            struct pollfd pfd = { this->_file_descriptor, POLLIN, 0 };
+            int           ready = poll(&pfd, 1, timeout);
+
+            if (ready == -1)
+                throw mysocket::error(errno);
+
+            if (ready == 0)
+                throw mysocket::error(ETIMEDOUT);
+        }
+
+        return _recv(this->_file_descriptor, buff);
+    }
+
+    std::string tcp_client::recv(std::vector<int>& file_descriptors) const {
+        char              buff[4096];
+        std::vector<char> control(CMSG_SPACE(sizeof(int) * MAX_PASSED_FILE_DESCRIPTORS));
+        struct iovec      iov = { buff, sizeof(buff) };
+        struct msghdr     header;
+
+        memset(&header, 0, sizeof(header));
+
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control.data();
+        header.msg_controllen = control.size();
+
+        ssize_t len;
+
+        do
+            len = recvmsg(this->_file_descriptor, &header, MSG_CMSG_CLOEXEC);
+        while (len == -1 && errno == EINTR);
+
+        if (len == -1)
+            throw mysocket::error(errno);
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            size_t offset = file_descriptors.size();
+
+            file_descriptors.resize(offset + count);
+
+            memcpy(&file_descriptors[offset], CMSG_DATA(cmsg), sizeof(int) * count);
+        }
+
+        // Some were dropped; the rest are no use alone
+        if (header.msg_flags & MSG_CTRUNC) {
+            for (int file_descriptor: file_descriptors)
+                ::close(file_descriptor);
+
+            file_descriptors.clear();
+
+            throw mysocket::error(EMSGSIZE);
+        }
+
+        return std::string(buff, len);
+    }
+
+    size_t udp_socket::recv(const std::function<void(const std::vector<datagram>&)> callback) {
+        const size_t control_size = CMSG_SPACE(sizeof(int));
+        size_t       count = this->_options.batch_size,
+                     slot_size = this->_slot_size();
+
+        if (this->_recv_buffers.empty()) {
+            this->_recv_addresses.resize(count);
+            this->_recv_buffers.resize(count * slot_size);
+            this->_recv_control.resize(count * control_size);
+            this->_recv_iov.resize(count);
+
+            for (size_t i = 0; i < count; i++)
+                this->_recv_iov[i] = { &this->_recv_buffers[i * slot_size], slot_size };
+
+#ifdef __linux__
+            this->_recv_headers.resize(count);
+#endif
+        }
+
+        this->_recv_datagrams.clear();
+
+#ifdef __linux__
+        for (size_t i = 0; i < count; i++) {
+            struct msghdr& message = this->_recv_headers[i].msg_hdr;
+
+            // The kernel overwrites the lengths on every call
+            memset(&message, 0, sizeof(message));
+
+            message.msg_name = &this->_recv_addresses[i];
+            message.msg_namelen = sizeof(struct sockaddr_in);
+            message.msg_iov = &this->_recv_iov[i];
+            message.msg_iovlen = 1;
+            message.msg_control = &this->_recv_control[i * control_size];
+            message.msg_controllen = control_size;
+        }
+
+        int received;
+
+        // Blocks for the first datagram only, then takes whatever else is queued
+        while ((received = recvmmsg(this->_file_descriptor, this->_recv_headers.data(), (unsigned) count, MSG_WAITFORONE, NULL)) == -1 && errno == EINTR)
+            continue;
+
+        if (received == -1)
+            throw mysocket::error(errno);
+
+        for (int i = 0; i < received; i++) {
+            struct msghdr& message = this->_recv_headers[i].msg_hdr;
+            size_t         len = this->_recv_headers[i].msg_len,
+                           segment_size = len;
+
+            // Coalesced by GRO: equal-sized segments, the last one possibly shorter
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (cmsg->cmsg_level != SOL_UDP || cmsg->cmsg_type != UDP_GRO)
+                    continue;
+
+                int value;
+
+                memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+
+                if (value > 0)
+                    segment_size = value;
+            }
+
+            const char* data = (const char *)this->_recv_iov[i].iov_base;
+            size_t      offset = 0;
+
+            do {
+                this->_recv_datagrams.push_back({ this->_recv_addresses[i], std::string_view(data + offset, std::min(segment_size, len - offset)) });
+
+                offset += segment_size;
+            } while (offset < len);
+        }
+#else
+        // No recvmmsg; block for the first datagram, then take whatever else is queued
+        for (size_t i = 0; i < count; i++) {
+            socklen_t addrlen = sizeof(struct sockaddr_in);
+            ssize_t   len = ::recvfrom(this->_file_descriptor, this->_recv_iov[i].iov_base, slot_size, i ? MSG_DONTWAIT : 0, (struct sockaddr *)&this->_recv_addresses[i], &addrlen);
+
+            if (len == -1) {
+                if (i)
+                    break;
+
+                throw mysocket::error(errno);
+            }
+
+            this->_recv_datagrams.push_back({ this->_recv_addresses[i], std::string_view((const char *)this->_recv_iov[i].iov_base, len) });
+        }
+#endif
+
+        // sendto() answers the latest sender, as after recvfrom()
+        if (this->_recv_datagrams.size())
+            *this->_address = this->_recv_datagrams.back().address;
+
+        callback(this->_recv_datagrams);
+
+        return this->_recv_datagrams.size();
     }
 
     std::string udp_socket::recvfrom() const {
-        char      buff[1024];
+        // Sized for the largest datagram, which used to overflow a fixed buffer, once; only what arrived is copied out
+        if (this->_recvfrom_buffer.empty())
+            this->_recvfrom_buffer.resize(this->_slot_size());
+
         socklen_t addrlen = sizeof(* this->_address);
-        ssize_t   len = ::recvfrom(this->_file_descriptor, (char *)buff, 1024, MSG_WAITALL, (struct sockaddr *)this->_address, &addrlen);
+        ssize_t   len = ::recvfrom(this->_file_descriptor, this->_recvfrom_buffer.data(), this->_recvfrom_buffer.size(), MSG_WAITALL, (struct sockaddr *)this->_address, &addrlen);
         
         if (len == -1)
             throw mysocket::error(errno);
         
-        buff[len] = '\0';
-        
-        return std::string(buff);
+        return std::string(this->_recvfrom_buffer.data(), len);
     }
 
-    int tcp_server::connection::send(const std::string message) const {
-        return _send(this->_file_descriptor, message);
+    int tcp_server::connection::send(const std::string message) {
+        if (this->_parent->_options.mode == THREADED) {
+#if TLS
+            if (this->_tls) {
+                struct iovec iov = { (void *)message.c_str(), message.length() };
+
+                return this->_tls_write(&iov, 1);
+            }
+#endif
+
+            return mysocket::_send(this->_file_descriptor, message);
+        }
+
+        // The queue belongs to the loop
+        if (!this->_loop->is_current()) {
+            tcp_server* parent = this->_parent;
+
+            this->_loop->post([parent, id = this->id(), message]() {
+                class connection* connection = parent->find(id);
+
+                if (connection)
+                    connection->send(message);
+            });
+
+            return (int) message.length();
+        }
+
+        if (this->_closed.load() || this->_closing)
+            return 0;
+
+        if (message.length() > buffer_pool::BUFFER_SIZE)
+            this->_output.push_back({ message });
+        else if (message.length())
+            this->_queue(message.data(), message.length());
+
+        this->_output_size.fetch_add(message.length());
+
+        this->_parent->_write(this);
+
+        return (int) message.length();
+    }
+
+    int tcp_server::connection::send(std::vector<std::string> buffers) {
+        if (this->_parent->_options.mode == THREADED) {
+            std::vector<struct iovec> iov;
+
+            for (const std::string& buffer: buffers)
+                iov.push_back({ (void *)buffer.c_str(), buffer.length() });
+
+#if TLS
+            if (this->_tls)
+                return this->_tls_write(iov.data(), iov.size());
+#endif
+
+            return mysocket::_send(this->_file_descriptor, iov.data(), iov.size());
+        }
+
+        size_t len = 0;
+
+        for (const std::string& buffer: buffers)
+            len += buffer.length();
+
+        // The queue belongs to the loop
+        if (!this->_loop->is_current()) {
+            tcp_server* parent = this->_parent;
+
+            this->_loop->post([parent, id = this->id(), buffers = std::move(buffers)]() mutable {
+                class connection* connection = parent->find(id);
+
+                if (connection)
+                    connection->send(std::move(buffers));
+            });
+
+            return (int) len;
+        }
+
+        if (this->_closed.load() || this->_closing)
+            return 0;
+
+        // The write gathers them
+        for (std::string& buffer: buffers) {
+            if (buffer.length() > buffer_pool::BUFFER_SIZE)
+                this->_output.push_back({ std::move(buffer) });
+            else if (buffer.length())
+                this->_queue(buffer.data(), buffer.length());
+        }
+
+        this->_output_size.fetch_add(len);
+        this->_parent->_write(this);
+
+        return (int) len;
+    }
+
+    int tcp_server::connection::send(std::shared_ptr<const std::string> body) {
+        if (body == nullptr)
+            return 0;
+
+        if (this->_parent->_options.mode == THREADED) {
+            struct iovec iov = { (void *)body->data(), body->length() };
+
+#if TLS
+            if (this->_tls)
+                return this->_tls_write(&iov, 1);
+#endif
+
+            return mysocket::_send(this->_file_descriptor, &iov, 1);
+        }
+
+        // The queue belongs to the loop
+        if (!this->_loop->is_current()) {
+            tcp_server* parent = this->_parent;
+
+            this->_loop->post([parent, id = this->id(), body]() {
+                class connection* connection = parent->find(id);
+
+                if (connection)
+                    connection->send(body);
+            });
+
+            return (int) body->length();
+        }
+
+        if (this->_closed.load() || this->_closing)
+            return 0;
+
+        if (body->length()) {
+            this->_output.push_back({ "", body });
+            this->_output_size.fetch_add(body->length());
+        }
+
+        this->_parent->_write(this);
+
+        return (int) body->length();
+    }
+
+    int tcp_server::connection::send_file_descriptors(const std::vector<int> file_descriptors, const std::string message) {
+        // A message carries at least a byte; the descriptors ride on it
+        if (message.empty() || file_descriptors.empty() || file_descriptors.size() > MAX_PASSED_FILE_DESCRIPTORS)
+            throw mysocket::error(EINVAL);
+
+        std::vector<char> control(CMSG_SPACE(sizeof(int) * file_descriptors.size()));
+        struct iovec      iov = { (void *)message.data(), message.length() };
+        struct msghdr     header;
+
+        memset(&header, 0, sizeof(header));
+
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control.data();
+        header.msg_controllen = control.size();
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * file_descriptors.size());
+
+        memcpy(CMSG_DATA(cmsg), file_descriptors.data(), sizeof(int) * file_descriptors.size());
+
+        while (true) {
+            ssize_t len = sendmsg(this->_file_descriptor, &header, MSG_NOSIGNAL);
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                // Event loop modes; wait until the kernel can take it
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    struct pollfd pfd = { this->_file_descriptor, POLLOUT, 0 };
+
+                    poll(&pfd, 1, -1);
+
+                    continue;
+                }
+
+                throw mysocket::error(errno);
+            }
+
+            // The descriptors went with the first byte
+            if ((size_t) len < message.length())
+                len += mysocket::_send(this->_file_descriptor, message.substr(len));
+
+            return (int) len;
+        }
+    }
+
+    void tcp_server::connection::output::release::operator()(char* block) const {
+        buffer_pool::release(block);
+    }
+
+    std::string_view tcp_server::connection::output::view() const {
+        if (this->block)
+            return std::string_view(this->block.get(), this->block_size);
+
+        return this->shared ? *this->shared : this->data;
+    }
+
+    void tcp_server::connection::timeout(const size_t timeout) {
+        if (this->_loop == NULL)
+            return;
+
+        // The timer wheel belongs to the loop
+        if (!this->_loop->is_current()) {
+            tcp_server* parent = this->_parent;
+
+            return this->_loop->post([parent, id = this->id(), timeout]() {
+                class connection* connection = parent->find(id);
+
+                if (connection)
+                    connection->timeout(timeout);
+            });
+        }
+
+        if (this->_closed.load())
+            return;
+
+        if (timeout)
+            this->_loop->timers().add(&this->_deadline, timeout);
+        else
+            this->_loop->timers().remove(&this->_deadline);
     }
 
     int tcp_client::send(const std::string message) const {
         return _send(this->_file_descriptor, message);
     }
 
+    size_t udp_socket::send(const std::vector<datagram>& datagrams) {
+        auto destination = [this](const datagram& datagram) {
+            return datagram.address.sin_family ? &datagram.address : this->_address;
+        };
+
+#ifdef __linux__
+        const size_t control_size = CMSG_SPACE(sizeof(uint16_t));
+
+        auto same_destination = [](const struct sockaddr_in* a, const struct sockaddr_in* b) {
+            return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+        };
+
+        // Sized up front; the headers point into them
+        if (this->_send_iov.size() < datagrams.size()) {
+            this->_send_control.resize(datagrams.size() * control_size);
+            this->_send_iov.resize(datagrams.size());
+        }
+
+        this->_send_headers.clear();
+
+        for (size_t i = 0; i < datagrams.size(); ) {
+            const struct sockaddr_in* address = destination(datagrams[i]);
+            size_t                    first = i,
+                                      total = datagrams[i].data.length();
+
+            this->_send_iov[i] = { (void *)datagrams[i].data.data(), datagrams[i].data.length() };
+
+            i++;
+
+            // A run of full segments to one destination, up to and including the first shorter one, goes out as one send
+            if (this->_options.gso_size && total == this->_options.gso_size) {
+                while (i < datagrams.size() && i - first < UDP_MAX_SEGMENTS && datagrams[i - 1].data.length() == this->_options.gso_size) {
+                    size_t len = datagrams[i].data.length();
+
+                    if (len == 0 || len > this->_options.gso_size || total + len > UDP_MAX_PAYLOAD || !same_destination(address, destination(datagrams[i])))
+                        break;
+
+                    this->_send_iov[i] = { (void *)datagrams[i].data.data(), len };
+
+                    total += len;
+                    i++;
+                }
+            }
+
+            struct mmsghdr header;
+
+            memset(&header, 0, sizeof(header));
+
+            header.msg_hdr.msg_name = (void *)address;
+            header.msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            header.msg_hdr.msg_iov = &this->_send_iov[first];
+            header.msg_hdr.msg_iovlen = i - first;
+
+            if (i - first > 1) {
+                uint16_t segment_size = this->_options.gso_size;
+
+                header.msg_hdr.msg_control = &this->_send_control[first * control_size];
+                header.msg_hdr.msg_controllen = control_size;
+
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header.msg_hdr);
+
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(segment_size));
+
+                memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+            }
+
+            this->_send_headers.push_back(header);
+        }
+
+        // sendmmsg may stop short of the full batch
+        for (size_t sent = 0; sent < this->_send_headers.size(); ) {
+            int len = sendmmsg(this->_file_descriptor, this->_send_headers.data() + sent, (unsigned) std::min(this->_send_headers.size() - sent, this->_options.batch_size), 0);
+
+            if (len == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                throw mysocket::error(errno);
+            }
+
+            sent += len;
+        }
+#else
+        // No sendmmsg; one call per datagram
+        for (const datagram& datagram: datagrams)
+            if (::sendto(this->_file_descriptor, datagram.data.data(), datagram.data.length(), 0, (const struct sockaddr *)destination(datagram), sizeof(struct sockaddr_in)) == -1)
+                throw mysocket::error(errno);
+#endif
+
+        return datagrams.size();
+    }
+
     int udp_socket::sendto(const std::string message) const {
         ssize_t len = ::sendto(this->_file_descriptor, (const char *)message.c_str(), message.length(), 0, (const struct sockaddr *)this->_address, sizeof(* this->_address));
         
@@ -348,7 +3025,43 @@ namespace mysocket {
         return (int) len;
     }
 
+    void tcp_server::submit_to(const size_t core, const std::function<void()> task) {
+        if (this->_loops.empty())
+            return task();
+
+        this->_loops[core % this->_loops.size()]->post(task);
+    }
+
+#ifdef __linux__
+    struct uring::statistics tcp_server::uring_stats() const {
+        struct uring::statistics result;
+
+        for (event_loop* loop: this->_loops) {
+            if (loop->ring() == NULL)
+                continue;
+
+            struct uring::statistics stats = loop->ring()->stats();
+
+            result.completions += stats.completions;
+            result.enters += stats.enters;
+            result.submissions += stats.submissions;
+        }
+
+        return result;
+    }
+#endif
+
     const char* error::what() const throw() {
         return this->_what.c_str();
     }
+
+    struct tcp_server::zerocopy_statistics tcp_server::zerocopy_stats() const {
+        struct zerocopy_statistics result;
+
+        result.completions = this->_zerocopy_completions.load();
+        result.copied = this->_zerocopy_copied.load();
+        result.sends = this->_zerocopy_sends.load();
+
+        return result;
+    }
 }
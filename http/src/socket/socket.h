@@ -8,23 +8,57 @@
 #ifndef socket_h
 #define socket_h
 
+#include "buffer.h"
+#include "event_loop.h"
+#include "task.h"
+#include "tls.h"
+#include "transport.h"
 #include "util.h"
-#include <arpa/inet.h>  // inet_ptons
-#include <csignal>      // signal
+#include <arpa/inet.h>      // inet_ptons
+#include <climits>          // IOV_MAX
+#include <condition_variable>
+#include <coroutine>
+#include <csignal>          // signal
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <netinet/in.h> // sockaddr_in
-#include <sys/socket.h> // socket
+#include <netinet/in.h>     // sockaddr_in
+#include <netdb.h>          // getaddrinfo
+#include <netinet/tcp.h>    // TCP_CORK, TCP_NOPUSH
+#include <poll.h>           // poll
+#include <sys/socket.h>     // socket
+#include <sys/uio.h>        // iovec
+#include <sys/un.h>         // sockaddr_un
 #include <thread>
-#include <unistd.h>     // close, read
+#include <type_traits>      // invoke_result_t
+#include <unistd.h>         // close, read
+
+#ifdef __linux__
+#include <linux/errqueue.h> // sock_extended_err, SO_EE_ORIGIN_ZEROCOPY
+#include <linux/filter.h>   // sock_filter, sock_fprog
+#include <netinet/udp.h>    // UDP_GRO, UDP_SEGMENT
+#include <sched.h>          // sched_getaffinity
+#endif
 
 namespace mysocket {
     // Typedef
     
+    // Peer process of a Unix domain connection, as of connect(); -1 where unknown
+    struct credentials {
+        pid_t pid = -1;
+        uid_t uid = -1;
+        gid_t gid = -1;
+    };
+
     struct error: public std::exception {
         // Constructors
 
         error(const int errnum);
 
+        error(const int errnum, const std::string what);
+
         // Member Fields
 
         int         errnum() const;
@@ -40,14 +74,29 @@ namespace mysocket {
     struct tcp_client {
         // Constructors
 
-        tcp_client(const std::string host, const int port);
+        // Connects to a Unix domain socket; see tcp_server(path, ...)
+        tcp_client(const std::string path);
+
+        // host is a name or a numeric address, or a Unix domain socket path starting with '/' or '@' (port is then ignored);
+        // timeout bounds the connect, in milliseconds (-1 for none)
+        tcp_client(const std::string host, const int port, const int timeout = -1);
 
         // Member Functions
 
         void        close();
 
+        // Of the listening process; see tcp_server::connection::credentials()
+        struct credentials credentials() const;
+
         std::string recv() const;
 
+        // Appends what arrives to buff; returns 0 once the peer has closed. Throws ETIMEDOUT after timeout milliseconds (-1 for none)
+        size_t      recv(buffer& buff, const int timeout = -1) const;
+
+        // One message, appending the descriptors passed with it (SCM_RIGHTS) to file_descriptors; see
+        // tcp_server::connection::send_file_descriptors(). They are the caller's, and close-on-exec where supported
+        std::string recv(std::vector<int>& file_descriptors) const;
+
         int         send(const std::string message) const;
     private:
         // Constructors
@@ -63,33 +112,417 @@ namespace mysocket {
     struct tcp_server {
         // Typedef
 
+        enum io_mode {
+            // Blocking accept loop; the handler owns each connection
+            THREADED,
+            // Edge-triggered readiness loops; the handler registers callbacks
+            EVENT_LOOP,
+            // Event loops driven by io_uring completions (multishot accept, provided-buffer
+            // receive, batched send); falls back to EVENT_LOOP where unsupported
+            IO_URING
+        };
+
+        struct options {
+            int         backlog = 1024;
+            // Linux: microseconds to busy-poll the device queue on a blocking read before sleeping (SO_BUSY_POLL); 0 to disable
+            int         busy_poll = 0;
+            // Linux: seconds accept() waits for the first data, so idle handshakes never wake a loop (TCP_DEFER_ACCEPT); 0 to disable
+            int         defer_accept = 0;
+            // Pending TCP Fast Open requests, whose data rides on the SYN (TCP_FASTOPEN); 0 to disable
+            int         fastopen = 0;
+            // Bytes queued for sending at which a connection turns congested(); 0 to disable. Event loop modes only
+            size_t      high_watermark = 1 << 20;
+            // Milliseconds without input before a connection is closed; 0 to disable. Event loop modes only
+            size_t      idle_timeout = 0;
+            // Linux: bind listener i to CPU i, so SO_REUSEPORT prefers the listener local to the CPU that took the packet
+            // (SO_INCOMING_CPU); pair with listeners = 0
+            bool        incoming_cpu = false;
+            // Number of SO_REUSEPORT listeners, each with its own accept loop and connections; 0 for one per hardware thread
+            size_t      listeners = 1;
+            // Milliseconds close() waits for queued output to drain before dropping it
+            size_t      linger_timeout = 30000;
+            // Bytes queued for sending at which a congested connection recovers and on_writable() runs
+            size_t      low_watermark = 1 << 18;
+            // Open connections beyond which new ones are turned away with reject_message; 0 for no limit
+            size_t      max_connections = 0;
+            // Bytes queued for sending beyond which the connection is closed as a slow reader; 0 for no limit
+            size_t      max_output = 0;
+            io_mode     mode = THREADED;
+            // Send small responses at once instead of waiting on Nagle's algorithm (TCP_NODELAY)
+            bool        nodelay = true;
+            // Linux: acknowledge at once instead of delaying the ACK, set on each accepted socket (TCP_QUICKACK)
+            bool        quickack = false;
+            // Bytes; 0 for the kernel's default and autotuning (SO_RCVBUF)
+            int         receive_buffer = 0;
+            // Written, best effort, to connections turned away by max_connections or descriptor exhaustion,
+            // e.g. a precomputed 503 response; empty to just close them
+            std::string reject_message = "";
+            // Bytes; 0 for the kernel's default and autotuning (SO_SNDBUF)
+            int         send_buffer = 0;
+            // Listeners passed to tcp_server(file_descriptors, ...) may be shared with other processes, which go on
+            // accepting from them; false where this process alone serves them, so drain() shuts them down as it would
+            // listeners it bound, and new peers are refused at once
+            bool        shared_listeners = true;
+            // Linux: have the kernel pick the listener of the CPU that took the connection
+            bool        steering = false;
+            // Shared-nothing: one event loop per allowed CPU (or per threads, if set), pinned to it, with its own
+            // SO_REUSEPORT listener, connection table and timers. Connections never leave the core that accepted
+            // them, and memory is first touched there, so it stays NUMA-local; cores talk through submit_to().
+            // Implies steering and incoming_cpu; event loop modes over TCP only
+            bool        thread_per_core = false;
+            // Number of event loops; 0 for one per hardware thread
+            size_t      threads = 0;
+#if TLS
+            // Speak TLS on every connection; the context must outlive the server. IO_URING runs as EVENT_LOOP,
+            // since OpenSSL reads and writes the socket itself
+            tls_context* tls = NULL;
+#endif
+            // Linux: queued messages of at least this many bytes are sent in place (MSG_ZEROCOPY, or IORING_OP_SEND_ZC)
+            // and kept until the kernel is done with them, rather than copied into it; 0 to disable. Pays off from
+            // about 10KB; event loop modes, over TCP without TLS
+            size_t      zerocopy_threshold = 0;
+        };
+
+        struct zerocopy_statistics {
+            // Sends the kernel copied after all, e.g. over loopback; their connections copy from then on
+            size_t copied = 0;
+            // Zero-copy sends the kernel has finished with
+            size_t completions = 0;
+            size_t sends = 0;
+        };
+
+        class connection_table;
+
+        class shard;
+
         class connection {
+            // Typedef
+
+            // A queued message, owned or shared, or messages copied into a block from buffer_pool
+            struct output {
+                // Typedef
+
+                // Gives the block back to the pool
+                struct release {
+                    void operator()(char* block) const;
+                };
+
+                // Member Fields
+
+                std::string                        data;
+                // Set instead of data by send(shared_ptr)
+                std::shared_ptr<const std::string> shared = nullptr;
+                // Set instead of data by send() for what fits; later messages are appended while there is room
+                std::unique_ptr<char, release>     block = nullptr;
+                // Bytes used in block
+                size_t                             block_size = 0;
+                // A zero-copy send took from it; kept until zerocopy_id completes
+                bool                               zerocopy = false;
+                // Last zero-copy send that took from it
+                uint32_t                           zerocopy_id = 0;
+
+                // Member Functions
+
+                std::string_view view() const;
+            };
+
             // Constructors
 
-            connection(tcp_server* parent, const int file_descriptor);
+            connection(tcp_server* parent);
 
             ~connection();
 
             // Member Fields
 
-            int         _file_descriptor;
-            tcp_server* _parent = NULL;
+            std::atomic<bool>                _closed = false;
+            // close() was called with output queued; see linger_timeout
+            bool                             _closing = false;
+            std::atomic<bool>                _congested = false;
+            // See context()
+            std::shared_ptr<void>            _context;
+            // Closes the connection when it fires; see timeout()
+            timer_wheel::timer               _deadline;
+            int                              _file_descriptor = -1;
+#if TLS
+            // Input and output wait until the TLS handshake completes
+            bool                             _handshaking = false;
+#endif
+            // Generation-tagged handle of the current use; see id()
+            std::atomic<uint64_t>            _id = 0;
+            // Re-armed on every read while options.idle_timeout is set
+            timer_wheel::timer               _idle;
+            // Slot in the connection table, kept across reuse
+            uint32_t                         _index = 0;
+            buffer                           _input;
+            event_loop*                      _loop = NULL;
+            std::function<void(connection*)> _on_readable;
+            std::function<void(connection*)> _on_writable;
+            // Messages up to buffer_pool::BUFFER_SIZE are copied into pool blocks, so a drained queue holds no
+            // buffers; larger ones are queued as they are
+            std::deque<output>               _output;
+            // iovecs and header of the send in flight, over the front of the queue
+            std::vector<struct iovec>        _output_iov;
+            struct msghdr                    _output_message;
+            size_t                           _output_offset = 0;
+            // Bytes in the queue not yet taken by the kernel
+            std::atomic<size_t>              _output_size = 0;
+            tcp_server*                      _parent = NULL;
+            // io_uring operations in flight; the connection outlives them
+            size_t                           _pending = 0;
+            // Coroutine suspended in async_recv()
+            std::coroutine_handle<>          _reader;
+            event_loop::operation            _recv_operation;
+            event_loop::operation            _send_operation;
+            // A send is in flight (IO_URING), or the socket is full and watched for writability (EVENT_LOOP)
+            bool                             _sending = false;
+#if TLS
+            // NULL for plaintext
+            SSL*                             _tls = NULL;
+            // kTLS took the send side: the kernel encrypts plain writes, so they bypass OpenSSL
+            bool                             _tls_offloaded = false;
+            // Small queued buffers joined into one record; holds a pool block only during SSL_write()
+            buffer                           _tls_record;
+#endif
+            // In place of the socket, which is then -1; see tcp_server::open()
+            std::shared_ptr<transport>       _transport;
+            event_loop::watcher              _watcher;
+            // Coroutine suspended in async_send()
+            std::coroutine_handle<>          _writer;
+            // Send large messages in place: options.zerocopy_threshold is set, there is no TLS, and the kernel has not
+            // been copying them anyway
+            bool                             _zerocopy = false;
+            // Zero-copy sends below this id have completed
+            uint32_t                         _zerocopy_done = 0;
+            // Sent in place, and kept until the kernel is done with them
+            std::deque<output>               _zerocopy_held;
+            // Id of the next zero-copy send, counted as the kernel counts them
+            uint32_t                         _zerocopy_next = 0;
+            // Completed ahead of _zerocopy_done: first id to last id
+            std::map<uint32_t, uint32_t>     _zerocopy_ranges;
 
             // Member Functions
 
-            void _close();
+            // Drops len bytes from the front of the queue, once the kernel has taken them
+            void    _consume(const size_t len);
+
+            // THREADED: blocks until input arrives, completing the TLS handshake first; 0 once the peer has closed
+            size_t  _fill();
+
+            // Copies a message of up to buffer_pool::BUFFER_SIZE bytes into the last block while it has room, else
+            // into a new one
+            void    _queue(const char* data, const size_t len);
+
+            // recv(), SSL_read() over TLS, or the transport's; -1 with errno EAGAIN when nothing can be read yet
+            ssize_t _recv(char* data, const size_t len);
+
+            void    _reset(const int file_descriptor);
+
+            void    _resume();
+
+            // Non-blocking sendmsg(), SSL_write() over TLS without kTLS, or the transport's send()
+            ssize_t _send(const struct msghdr* message, const int flags = 0);
+
+            // Sends close_notify, best effort, and frees the session
+            void    _tls_close();
+
+            // Stops the transport's callbacks and closes it, so the peer reads end of stream
+            void    _transport_close();
+
+#if TLS
+            // Writes records until OpenSSL would block; the number of bytes taken, or -1 with errno
+            ssize_t _tls_send(const struct iovec* iov, const size_t count);
+
+            // THREADED: blocks until every byte is taken, completing the handshake first
+            int     _tls_write(struct iovec* iov, size_t count);
+#endif
+
+            // Zero-copy sends first to last are done; releases what no longer pinned
+            void    _zerocopy_complete(const uint32_t first, const uint32_t last);
         public:
             // Typdef
 
+            struct recv_awaiter {
+                // Member Fields
+
+                class connection* connection;
+
+                // Member Functions
+
+                bool        await_ready();
+
+                void        await_suspend(std::coroutine_handle<> handle);
+
+                // Everything in input(); empty once the connection has closed
+                std::string await_resume();
+            };
+
+            struct send_awaiter {
+                // Member Fields
+
+                class connection* connection;
+                int               length;
+
+                // Member Functions
+
+                bool        await_ready();
+
+                void        await_suspend(std::coroutine_handle<> handle);
+
+                int         await_resume();
+            };
+
+            friend connection_table;
             friend tcp_server;
 
             // Member Functions
 
+            // Awaitable recv(); suspends on the connection's loop until input arrives or the connection closes
+            recv_awaiter async_recv();
+
+            // Awaitable send(); in event loop modes, resumes once the kernel has taken every queued byte
+            send_awaiter async_send(std::vector<std::string> buffers);
+
+            // Bytes queued by send() and not yet taken by the kernel; always 0 in THREADED mode
+            size_t      buffered() const;
+
+            // In event loop modes, queued output is sent first, for up to options.linger_timeout milliseconds;
+            // input arriving meanwhile is ignored
             void        close();
 
-            std::string recv() const;
+            // From when buffered() reaches options.high_watermark until it falls back to options.low_watermark;
+            // producers should pause meanwhile, and resume from on_writable()
+            bool        congested() const;
+
+            // What the handler keeps for this use of the connection, e.g. a session, so callbacks need not capture it;
+            // released once the connection has closed
+            template <typename T>
+            std::shared_ptr<T> context() const {
+                return std::static_pointer_cast<T>(this->_context);
+            }
+
+            void        context(const std::shared_ptr<void> value);
+
+            // Hold back partial segments until uncorked, so several sends leave as full ones; a no-op in IO_URING mode,
+            // where queued sends already go out together, and over a transport
+            void        cork(const bool value);
+
+            // SO_PEERCRED, or getpeereid() where that is missing; AF_UNIX connections only
+            struct credentials credentials() const;
+
+            // Bytes received and not yet consumed; callbacks frame and consume requests in place
+            buffer&     input();
+
+            void        on_readable(const std::function<void(connection*)> callback);
+
+            // Runs on the connection's loop when a congested connection has drained to options.low_watermark
+            void        on_writable(const std::function<void(connection*)> callback);
+
+            // Takes everything in input(), reading first in THREADED mode
+            std::string recv();
+
+            // Identifies this use of the connection; objects are pooled, so hold on to the id, not the pointer,
+            // when the connection may have closed in the meantime
+            uint64_t    id() const;
+
+            // Never blocks in event loop modes: what the kernel will not take yet is queued, and sent as the socket drains
+            int         send(const std::string message);
+
+            // Sends the buffers in order with a single gathered write, without joining them
+            int         send(std::vector<std::string> buffers);
+
+            // Queues the body by reference rather than copying it, e.g. a cached file served to many connections;
+            // it is kept until the kernel is done with it, as options.zerocopy_threshold needs
+            int         send(std::shared_ptr<const std::string> body);
+
+            // Passes open descriptors, e.g. listeners, to the peer process with the message (SCM_RIGHTS); the peer gets
+            // its own copies. AF_UNIX connections without TLS, with nothing queued, and at most 253 descriptors
+            int         send_file_descriptors(const std::vector<int> file_descriptors, const std::string message);
+
+            // Closes the connection unless called again within timeout milliseconds; 0 to cancel.
+            // Event loop modes only, e.g. for header-read and keep-alive deadlines
+            void        timeout(const size_t timeout);
+        };
+
+        // Slab of pooled connections addressed by generation-tagged ids: O(1) insert and remove, and lookups that take no lock
+        class connection_table {
+            // Typedef
+
+            struct slot {
+                // Allocated on first use, then reused
+                class connection*     connection = NULL;
+                // Odd while open; bumped on insert and on remove, so stale ids stop matching
+                std::atomic<uint32_t> generation = 0;
+                // Next free slot plus one
+                std::atomic<uint32_t> next = 0;
+            };
+
+            // Member Fields
+
+            static const size_t   CHUNK_SIZE = 1024;
+            static const size_t   MAX_CHUNKS = 4096;
+
+            // Chunks never move or shrink, so readers index them without a lock
+            std::atomic<slot*>    _chunks[MAX_CHUNKS];
+            // Connections findable right now
+            std::atomic<size_t>   _count = 0;
+            // Free list head: ABA tag in the high half, slot plus one in the low half
+            std::atomic<uint64_t> _free = 0;
+            // Slots handed out so far
+            std::atomic<uint32_t> _size = 0;
+            // Carried in every id, so a lookup finds its table among several
+            uint32_t              _tag = 0;
+
+            // Member Functions
+
+            slot*             _slot(const uint32_t index) const;
+        public:
+            // Constructors
+
+            connection_table(const uint32_t tag = 0);
+
+            ~connection_table();
+
+            // Member Functions
+
+            // A pooled connection, not yet findable
+            class connection* acquire(tcp_server* parent);
+
+            std::vector<class connection*> connections() const;
+
+            // NULL once the id's connection has been removed
+            class connection* find(const uint64_t id) const;
+
+            // Makes the connection findable under a new id
+            void              insert(class connection* connection);
+
+            // Returns the connection to the pool; the caller is done with it
+            void              release(class connection* connection);
+
+            // Returns the removed connection, or NULL if the id was already removed
+            class connection* remove(const uint64_t id);
 
-            int         send(const std::string message) const;
+            size_t            size() const;
+        };
+
+        // A listening socket with its own accept loop and connections
+        class shard {
+            // Constructors
+
+            shard(const int file_descriptor);
+
+            // Member Fields
+
+            // Where its connections are kept; its own in thread-per-core mode
+            connection_table*        _connections = NULL;
+            int                      _file_descriptor;
+            std::thread              _listener;
+            event_loop::watcher      _listener_watcher;
+            // Event loop its connections stay on; NULL to spread them over every loop
+            event_loop*              _loop = NULL;
+        public:
+            // Typdef
+
+            friend tcp_server;
         };
 
         // Constructors
@@ -98,49 +531,303 @@ namespace mysocket {
 
         tcp_server(const int port, const std::function<void(connection*)> handler, const int backlog = 1024);
 
+        tcp_server(const int port, const std::function<void(connection*)> handler, const struct options options);
+
+        // Listens on a Unix domain socket, for callers on the same host. A path starting with '@' names a Linux abstract
+        // socket, which has no file; otherwise a stale socket file is replaced, and the file is removed on close().
+        // One listener, whatever options.listeners says
+        tcp_server(const std::string path, const std::function<void(connection*)> handler, const int backlog = 1024);
+
+        tcp_server(const std::string path, const std::function<void(connection*)> handler, const struct options options);
+
+        // Serves listening sockets bound elsewhere, e.g. by listen() before a fork, and takes over this process's copies
+        // of them. Unless options.shared_listeners is false, the sockets are left for the other processes sharing them:
+        // drain() and close() neither shut them down nor remove a socket file. options.listeners does not apply
+        tcp_server(const std::vector<int> file_descriptors, const std::function<void(connection*)> handler, const struct options options);
+
+        // Binds nothing, and serves only what open() hands it, in EVENT_LOOP mode whatever options.mode says
+        tcp_server(const std::function<void(connection*)> handler, const struct options options);
+
+        // Serves each connection with a coroutine: the task<> the handler returns starts on the connection's event
+        // loop, and is resumed there by async_recv() and async_send() until it returns. In THREADED mode it runs on the
+        // connection's thread, where those complete in place
+        template <typename Handler> requires std::is_same_v<std::invoke_result_t<Handler&, connection*>, task<>>
+        tcp_server(const int port, Handler handler, const struct options options) {
+            this->_inet(port);
+            this->_start(_spawn(handler), options);
+        }
+
+        // See tcp_server(path, ...)
+        template <typename Handler> requires std::is_same_v<std::invoke_result_t<Handler&, connection*>, task<>>
+        tcp_server(const std::string path, Handler handler, const struct options options) {
+            this->_unix(path);
+            this->_start(_spawn(handler), options);
+        }
+
         // Member Functions
 
         void                     close();
 
         void                     close(class connection* connection);
 
+        // Safe with a stale id; a connection that already closed, or whose object was reused, is left alone
+        void                     close(const uint64_t id);
+
         std::vector<connection*> connections();
+
+        // Stops accepting, closes connections waiting on a timeout() (idle keep-alives, unanswered handshakes), then
+        // blocks until the rest have been closed by their handlers, or timeout milliseconds pass. close() still follows
+        void                     drain(const size_t timeout);
+
+        // From drain() on; handlers should make each response the last on its connection
+        bool                     draining() const;
+
+        // Event loops; one per core in thread-per-core mode, none in THREADED mode
+        size_t                   cores() const;
+
+        // NULL once the connection has closed
+        class connection*        find(const uint64_t id) const;
+
+        // Binds options.listeners listening sockets on the port without serving them, for a server in this or another
+        // process to adopt; see tcp_server(file_descriptors, ...). The caller owns them
+        static std::vector<int>  listen(const int port, const struct options options);
+
+        // Effective mode, after any fallback
+        io_mode                  mode() const;
+
+        // Serves a connection over the transport instead of a socket, e.g. one end of a loopback, so the handler and
+        // everything above it run without the kernel. It goes through the readiness path of an event loop, in either
+        // event loop mode, with neither TLS nor zero-copy. Returns its id; ECONNREFUSED once draining or at
+        // options.max_connections, and ENOTSUP in THREADED mode
+        uint64_t                 open(std::shared_ptr<transport> transport);
+
+        // Runs the task on the connection's event loop, if the connection is still open by then; inline in THREADED mode.
+        // The way back from other threads, e.g. a worker_pool
+        void                     post(const uint64_t id, const std::function<void(connection*)> task);
+
+#ifdef __linux__
+        // Summed over every loop; zero unless in IO_URING mode
+        struct uring::statistics uring_stats() const;
+#endif
+
+        // Runs the task on the core's event loop; the way to share work or state between cores without locking
+        // the request path. Inline in THREADED mode
+        void                     submit_to(const size_t core, const std::function<void()> task);
+
+        struct zerocopy_statistics zerocopy_stats() const;
     private:
+        // Typedef
+
+        template <typename Handler, typename Policy>
+        friend struct basic_tcp_server;
+
         // Constructors
 
-        ~tcp_server();
+        // Unbound (AF_UNSPEC) and not started
+        tcp_server();
+
+        virtual ~tcp_server();
 
         // Member Fields
 
-        struct sockaddr_in               _address;
-        int                              _address_length;
-        std::vector<connection*>         _connections;
-        int                              _file_descriptor;
-        std::function<void(connection*)> _handler = [](const class connection* connection){ };
-        std::thread                      _listener;
-        std::mutex                       _mutex;
-        std::atomic<bool>                _shut_down = false;
+        std::vector<event_loop::operation> _accept_operations;
+        // Wait for a pending connection instead of retrying an accept that fails for want of descriptors
+        std::vector<event_loop::operation> _accept_polls;
+        // Accept loops still running; drain() waits on those of adopted listeners
+        std::atomic<size_t>                _accepting = 0;
+        // Serving listeners bound elsewhere, which other processes may share
+        bool                               _adopted = false;
+        // AF_INET or AF_UNIX
+        struct sockaddr_storage            _address;
+        socklen_t                          _address_length;
+        // Thread-per-core: the CPUs the loops are pinned to, from the process's affinity mask
+        std::vector<int>                   _cpus;
+        // Signalled as connections close while draining
+        std::condition_variable            _drain_condition;
+        std::mutex                         _drain_mutex;
+        std::atomic<bool>                  _draining = false;
+        std::function<void(connection*)>   _handler = [](const class connection* connection){ };
+        std::vector<event_loop*>           _loops;
+        std::atomic<bool>                  _multishot = true;
+        std::atomic<size_t>                _next_loop = 0;
+        struct options                     _options;
+        // Held open to give back when descriptors run out, so pending connections can still be accepted and turned away
+        int                                _reserve_file_descriptor = -1;
+        std::mutex                         _reserve_mutex;
+        // Cleared if the kernel predates IORING_OP_SEND_ZC
+        std::atomic<bool>                  _send_zc = true;
+        std::vector<shard*>                _shards;
+        std::atomic<bool>                  _shut_down = false;
+        // Set by basic_tcp_server to its handler's on_readable(), called in place of connection::on_readable() callbacks
+        void                               (*_static_readable)(tcp_server* server, class connection* connection) = NULL;
+        // One per core in thread-per-core mode, otherwise just one
+        std::vector<connection_table*>     _tables;
+        std::vector<std::thread>           _threads;
+        std::atomic<size_t>                _zerocopy_completions = 0;
+        std::atomic<size_t>                _zerocopy_copied = 0;
+        std::atomic<size_t>                _zerocopy_sends = 0;
 
         // Member Functions
 
-        int _find_connection(const class connection* connection);
+        void              _accept(shard* shard);
+
+        // An accept loop has stopped for drain()
+        void              _accept_stopped();
+
+        // Serves listening sockets bound elsewhere; see tcp_server(file_descriptors, ...)
+        void              _adopt(const std::vector<int> file_descriptors);
+
+        // Turns the connection away if options.max_connections is reached; false once it has been closed.
+        // Each table counts its own connections, against its share of the limit
+        bool              _admit(const int file_descriptor, shard* shard);
+
+        void              _arm(class connection* connection);
+
+        // Runs after output was taken: recovers congested connections, resumes writers, finishes lingering closes
+        void              _drained(class connection* connection);
+
+        // EVENT_LOOP: writes the queue until the socket is full, then waits for writability
+        void              _flush(class connection* connection);
+
+        // Moves the TLS handshake on; true once complete. A failed handshake closes the connection, except in THREADED mode
+        bool              _handshake(class connection* connection);
+
+        // Every local IPv4 address, at the port
+        void              _inet(const int port);
+
+        int               _listen();
 
-        int _find_connection(const class connection* connection, const size_t start, const size_t end);
+        // Changes what the connection's watcher waits for; a transport reports readiness through on_ready() instead
+        void              _modify(class connection* connection, const int events);
+
+        class connection* _open(const int file_descriptor, shard* shard, event_loop* loop);
+
+        // EVENT_LOOP: takes zero-copy notifications off the socket's error queue
+        void              _reap(class connection* connection);
+
+        void              _read(class connection* connection);
+
+        // Hands new input to the handler, unless the connection is closing
+        void              _readable(class connection* connection);
+
+        // Writes options.reject_message and closes, without blocking
+        void              _reject(const int file_descriptor);
+
+        // Out of descriptors: spends the reserve to accept one pending connection and turn it away, rather than
+        // leave it queued with the listener readable forever. False if none was pending
+        bool              _shed(const int file_descriptor);
+
+        // Detaches each connection's task where the handler is called, on the connection's loop
+        static std::function<void(connection*)> _spawn(const std::function<task<>(connection*)> handler);
+
+        void              _start(const std::function<void(connection*)> handler, const struct options options);
+
+        void              _steer();
+
+        // The table an id belongs to; NULL for an id no table issued
+        connection_table* _table(const uint64_t id) const;
+
+        // Applies the options to a listener, before bind(); accepted sockets inherit them. Returns -1 and sets errno on failure
+        int               _tune(const int file_descriptor) const;
+
+        void              _unix(const std::string path);
+
+        // Stops accepting on adopted listeners, leaving their queues to the other processes sharing them
+        void              _unlisten();
+
+        void              _uring_accept(const size_t index);
+
+        void              _uring_recv(class connection* connection);
+
+        void              _uring_release(class connection* connection);
+
+        void              _uring_send(class connection* connection);
+
+        // Completions of one IORING_OP_SEND_ZC: the send itself, then a notification once the kernel is done with the buffer
+        void              _uring_zerocopy(class connection* connection, event_loop::operation* operation, const uint32_t id, const int result, const unsigned flags);
+
+        // Points the connection's watcher at the readiness paths: the handshake, then the error queue, writes and reads
+        void              _watch(class connection* connection);
+
+        // Starts sending what send() queued, then applies the watermarks and options.max_output
+        void              _write(class connection* connection);
     };
 
     struct udp_socket {
+        // Typedef
+
+        struct datagram {
+            // Sender, once received; destination, to send. Left zeroed, send() uses the address sendto() would
+            struct sockaddr_in address;
+            // Received data stays valid until the batch callback returns
+            std::string_view   data;
+        };
+
+        struct options {
+            // Datagrams per recvmmsg or sendmmsg call
+            size_t batch_size = 64;
+            // Linux: have the kernel coalesce datagrams from one sender into fewer, larger reads (UDP_GRO);
+            // recv() splits them back apart
+            bool   gro = false;
+            // Linux: send() hands runs of datagrams of exactly this size, to one destination, to the kernel as one
+            // segmented send (UDP_SEGMENT); 0 to disable
+            size_t gso_size = 0;
+            // Larger datagrams are truncated
+            size_t max_datagram_size = 65507;
+        };
+
         // Member Functions
 
         void        close();
 
+        // Waits for at least one datagram, then takes up to options.batch_size in one call and passes them to the
+        // callback. Buffers are reused from batch to batch, so receive on one thread at a time. Returns the number received
+        size_t      recv(const std::function<void(const std::vector<datagram>&)> callback);
+
         std::string recvfrom() const;
 
+        // Sends the datagrams in order, in as few calls as the batch size allows; returns the number sent
+        size_t      send(const std::vector<datagram>& datagrams);
+
         int         sendto(const std::string message) const;
     protected:
+        // Constructors
+
+        udp_socket(const struct options options);
+
         // Member Fields
 
         struct sockaddr_in* _address = NULL;
         int                 _file_descriptor;
+        struct options      _options;
+
+        // Member Functions
+
+        // Applies the options, once the socket is open
+        void                _configure();
+    private:
+        // Member Fields
+
+        // Rings reused by recv() and send(), allocated on first use
+        std::vector<struct sockaddr_in> _recv_addresses;
+        std::vector<char>               _recv_buffers;
+        std::vector<char>               _recv_control;
+        std::vector<datagram>           _recv_datagrams;
+#ifdef __linux__
+        std::vector<struct mmsghdr>     _recv_headers;
+#endif
+        std::vector<struct iovec>       _recv_iov;
+        // Reused by recvfrom(), which is const
+        mutable std::vector<char>       _recvfrom_buffer;
+        std::vector<char>               _send_control;
+#ifdef __linux__
+        std::vector<struct mmsghdr>     _send_headers;
+#endif
+        std::vector<struct iovec>       _send_iov;
+
+        // Member Functions
+
+        size_t                          _slot_size() const;
     };
 
     class udp_client: public udp_socket {
@@ -151,6 +838,8 @@ namespace mysocket {
         // Constructors
 
         udp_client(const std::string host, const int port);
+
+        udp_client(const std::string host, const int port, const struct options options);
     };
 
     class udp_server: public udp_socket {
@@ -161,6 +850,8 @@ namespace mysocket {
         // Constructors
 
         udp_server(const int port);
+
+        udp_server(const int port, const struct options options);
     };
 }
 
@@ -0,0 +1,298 @@
+//
+//  supervisor.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "supervisor.h"
+#include "logger.h"
+#include "socket.h"
+#include <algorithm>
+#include <fcntl.h>          // fcntl, O_CREAT
+#include <sstream>
+#include <sys/mman.h>       // mmap, shm_open
+#include <sys/stat.h>       // fstat
+#include <sys/wait.h>       // waitpid
+
+#ifdef __linux__
+#include <sys/prctl.h>      // PR_SET_PDEATHSIG
+#else
+#include <mach-o/dyld.h>    // _NSGetExecutablePath
+#endif
+
+extern char** environ;
+
+namespace mysocket {
+    // Non-Member Fields
+
+    // Set in a worker's environment: its index, the descriptor of the counters, then options.file_descriptors
+    const std::string WORKER_VARIABLE = "SUPERVISOR_WORKER";
+
+    // Constructors
+
+    supervisor::supervisor(const std::function<void(const size_t index, counters* counters)> worker, const struct options options) {
+        static_assert(std::atomic<size_t>::is_always_lock_free, "counters are shared between processes");
+
+        if (getenv(WORKER_VARIABLE.c_str()))
+            _work(worker);
+
+        this->_options = options;
+        this->_parent = getpid();
+
+        char path[PATH_MAX];
+
+        // Resolved, rather than run as /proc/self/exe, so workers keep the program's name
+#ifdef __linux__
+        ssize_t path_length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+
+        this->_executable = path_length > 0 ? std::string(path, path_length) : "/proc/self/exe";
+#else
+        uint32_t path_length = sizeof(path);
+
+        this->_executable = _NSGetExecutablePath(path, &path_length) == 0 ? path : options.arguments.at(0);
+#endif
+
+        size_t nworkers = options.workers ? options.workers : std::max(std::thread::hardware_concurrency(), 1U);
+        size_t size = sizeof(struct counters) * nworkers;
+
+        // Unlinked once open; workers write to the same pages the supervisor reads
+        std::string name = "/supervisor-" + std::to_string(getpid());
+
+        this->_shared = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+        if (this->_shared == -1)
+            throw mysocket::error(errno);
+
+        shm_unlink(name.c_str());
+
+        void* counters = ftruncate(this->_shared, size) ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->_shared, 0);
+
+        if (counters == MAP_FAILED) {
+            int errnum = errno;
+
+            ::close(this->_shared);
+
+            throw mysocket::error(errnum);
+        }
+
+        this->_counters = (struct counters *)counters;
+
+        for (size_t i = 0; i < nworkers; i++)
+            new (&this->_counters[i]) struct counters();
+
+        this->_pids.assign(nworkers, -1);
+
+        this->_mutex.lock();
+
+        for (size_t i = 0; i < nworkers; i++)
+            this->_spawn(i);
+
+        this->_mutex.unlock();
+
+        this->_monitor = std::thread([this]() {
+            this->_supervise();
+        });
+    }
+
+    supervisor::~supervisor() { }
+
+    // Member Functions
+
+    void supervisor::_spawn(const size_t index) {
+        // Built before the fork: other threads may have held the allocator's lock, or _mutex, when the child was copied,
+        // so it makes only async-signal-safe calls until exec replaces it
+        std::string        variable = WORKER_VARIABLE + "=" + std::to_string(index) + " " + std::to_string(this->_shared);
+        std::vector<char*> arguments;
+        std::vector<char*> environment;
+
+        for (int file_descriptor: this->_options.file_descriptors)
+            variable += " " + std::to_string(file_descriptor);
+
+        for (std::string& argument: this->_options.arguments)
+            arguments.push_back(argument.data());
+
+        if (arguments.empty())
+            arguments.push_back(this->_executable.data());
+
+        arguments.push_back(NULL);
+
+        for (char** entry = environ; *entry; entry++)
+            if (strncmp(*entry, variable.c_str(), WORKER_VARIABLE.length() + 1))
+                environment.push_back(*entry);
+
+        environment.push_back(variable.data());
+        environment.push_back(NULL);
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+#ifdef __linux__
+            // Not left serving once the supervisor is gone; kept across exec
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+            if (getppid() != this->_parent)
+                _exit(0);
+#endif
+
+            // The rest close on exec, as they would in any child
+            fcntl(this->_shared, F_SETFD, 0);
+
+            for (int file_descriptor: this->_options.file_descriptors)
+                fcntl(file_descriptor, F_SETFD, 0);
+
+            execve(this->_executable.c_str(), arguments.data(), environment.data());
+
+            _exit(127);
+        }
+
+        if (pid == -1)
+            logger::error("fork: " + std::string(std::strerror(errno)));
+
+        this->_pids[index] = pid;
+    }
+
+    void supervisor::_supervise() {
+        while (true) {
+            int   status;
+            pid_t pid = waitpid(-1, &status, 0);
+            int   errnum = errno;
+
+            std::unique_lock<std::mutex> lock(this->_mutex);
+
+            if (pid == -1 && errnum == EINTR)
+                continue;
+
+            if (pid != -1) {
+                auto it = std::find(this->_pids.begin(), this->_pids.end(), pid);
+
+                if (it == this->_pids.end())
+                    continue;
+
+                *it = -1;
+
+                if (!this->_stopping)
+                    logger::error("worker " + std::to_string(pid) + (WIFSIGNALED(status) ? " killed by signal " + std::to_string(WTERMSIG(status)) : " exited with status " + std::to_string(WEXITSTATUS(status))));
+            }
+
+            if (this->_stopping) {
+                if ((size_t) std::count(this->_pids.begin(), this->_pids.end(), -1) == this->_pids.size())
+                    return;
+
+                continue;
+            }
+
+            // Wait out the delay before replacing it; stop() cuts it short
+            if (this->_condition.wait_for(lock, std::chrono::milliseconds(this->_options.restart_delay), [this]() {
+                return this->_stopping;
+            }))
+                continue;
+
+            for (size_t i = 0; i < this->_pids.size(); i++) {
+                if (this->_pids[i] != -1)
+                    continue;
+
+                this->_spawn(i);
+
+                if (this->_pids[i] != -1)
+                    this->_restarts.fetch_add(1);
+            }
+        }
+    }
+
+    void supervisor::_work(const std::function<void(const size_t index, counters* counters)> worker) {
+        std::istringstream iss(getenv(WORKER_VARIABLE.c_str()));
+        size_t             index;
+        int                shared;
+        struct stat        status;
+
+        iss >> index >> shared;
+
+        void* counters = fstat(shared, &status) ? MAP_FAILED : mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shared, 0);
+
+        if (counters == MAP_FAILED || (index + 1) * sizeof(struct counters) > (size_t) status.st_size) {
+            logger::error("worker: no counters");
+
+            _exit(1);
+        }
+
+        ::close(shared);
+
+        int result = 0;
+
+        try {
+            worker(index, &((struct counters *)counters)[index]);
+        } catch (std::exception& e) {
+            logger::error(e.what());
+
+            result = 1;
+        }
+
+        fflush(NULL);
+
+        // Skips static destructors, which could race threads worker left running
+        _exit(result);
+    }
+
+    void supervisor::close() {
+        this->stop();
+
+        munmap(this->_counters, sizeof(struct counters) * this->_pids.size());
+        ::close(this->_shared);
+
+        delete this;
+    }
+
+    std::vector<int> supervisor::inherited() {
+        std::vector<int> result;
+        const char*      variable = getenv(WORKER_VARIABLE.c_str());
+
+        if (variable == NULL)
+            return result;
+
+        std::istringstream iss(variable);
+        size_t             index;
+        int                shared,
+                           file_descriptor;
+
+        iss >> index >> shared;
+
+        while (iss >> file_descriptor)
+            result.push_back(file_descriptor);
+
+        return result;
+    }
+
+    struct supervisor::statistics supervisor::stats() const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        struct statistics           result;
+
+        for (size_t i = 0; i < this->_pids.size(); i++) {
+            result.accepted += this->_counters[i].accepted.load();
+            result.requests += this->_counters[i].requests.load();
+
+            if (this->_pids[i] != -1)
+                result.workers++;
+        }
+
+        result.restarts = this->_restarts.load();
+
+        return result;
+    }
+
+    void supervisor::stop() {
+        this->_mutex.lock();
+
+        this->_stopping = true;
+
+        for (pid_t pid: this->_pids)
+            if (pid != -1)
+                kill(pid, SIGTERM);
+
+        this->_condition.notify_all();
+        this->_mutex.unlock();
+
+        if (this->_monitor.joinable())
+            this->_monitor.join();
+    }
+}
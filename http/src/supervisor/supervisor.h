@@ -0,0 +1,109 @@
+//
+//  supervisor.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef supervisor_h
+#define supervisor_h
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/types.h>      // pid_t
+#include <thread>
+#include <vector>
+
+namespace mysocket {
+    // Prefork: serves from worker processes instead of threads. Each worker is forked and runs the program again,
+    // holding the listeners bound beforehand (see tcp_server::listen), and serves them with its own tcp_server and
+    // heap, so a crash takes down only its own connections and no two workers share a lock or an allocator. Workers
+    // that exit are restarted, and the counters they publish are summed
+    struct supervisor {
+        // Typedef
+
+        // One per worker, in memory shared with the supervisor; it outlives the process, so totals survive restarts
+        struct counters {
+            std::atomic<size_t> accepted = 0;
+            std::atomic<size_t> requests = 0;
+        };
+
+        struct options {
+            // main()'s, with which each worker runs the program again; the first names it
+            std::vector<std::string> arguments;
+            // Kept open across exec, at the same numbers, in every worker; see inherited()
+            std::vector<int>         file_descriptors;
+            // Milliseconds before a worker that exited is replaced, so one that fails at startup doesn't fork in a loop
+            size_t                   restart_delay = 1000;
+            // Worker processes; 0 for one per hardware thread
+            size_t                   workers = 0;
+        };
+
+        struct statistics {
+            size_t accepted = 0;
+            size_t requests = 0;
+            // Workers replaced after exiting on their own
+            size_t restarts = 0;
+            // Workers running
+            size_t workers = 0;
+        };
+
+        // Constructors
+
+        // Forks the workers, each of which runs the program again with options.arguments, its signal mask and
+        // options.file_descriptors. There, main() reaches this constructor again, which runs worker with the worker's
+        // index and counters and exits when it returns: make the same calls up to here, and start threads in worker
+        supervisor(const std::function<void(const size_t index, counters* counters)> worker, const struct options options);
+
+        // Member Functions
+
+        // In a worker, options.file_descriptors as the supervisor passed them; empty in any other process
+        static std::vector<int> inherited();
+
+        // Stops, if not already stopped
+        void              close();
+
+        struct statistics stats() const;
+
+        // Sends SIGTERM to every worker and waits for them all to exit; stats() still adds up afterwards
+        void              stop();
+    private:
+        // Constructors
+
+        ~supervisor();
+
+        // Member Fields
+
+        std::condition_variable                                      _condition;
+        // Shared with the workers, one per worker
+        counters*                                                    _counters = NULL;
+        // Run again by each worker
+        std::string                                                  _executable;
+        std::thread                                                  _monitor;
+        mutable std::mutex                                           _mutex;
+        struct options                                               _options;
+        pid_t                                                        _parent;
+        // -1 where no worker runs
+        std::vector<pid_t>                                           _pids;
+        std::atomic<size_t>                                          _restarts = 0;
+        // Backs _counters; inherited by each worker, where an anonymous mapping would not survive exec
+        int                                                          _shared = -1;
+        bool                                                         _stopping = false;
+
+        // Member Functions
+
+        // Caller holds _mutex; the child execs before it could need it
+        void              _spawn(const size_t index);
+
+        // Reaps workers as they exit, and replaces them until stop(). Reaps any child of the process, so fork nothing else
+        void              _supervise();
+
+        // Runs worker in a worker process, and exits
+        [[noreturn]] static void _work(const std::function<void(const size_t index, counters* counters)> worker);
+    };
+}
+
+#endif /* supervisor_h */
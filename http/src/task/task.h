@@ -0,0 +1,178 @@
+//
+//  task.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef task_h
+#define task_h
+
+#include "logger.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace mysocket {
+    // Typedef
+
+    // Result slot of a task's promise; void tasks have none
+    template <typename T>
+    struct task_result {
+        // Member Fields
+
+        std::optional<T> value;
+
+        // Member Functions
+
+        T    result() {
+            return std::move(* this->value);
+        }
+
+        void return_value(T value) {
+            this->value = std::move(value);
+        }
+    };
+
+    template <>
+    struct task_result<void> {
+        // Member Functions
+
+        void result() { }
+
+        void return_void() { }
+    };
+
+    // Lazily started coroutine: runs when awaited, or when detached, and resumes its awaiter when done.
+    // Awaiting the connection's async_recv() and async_send() keeps a task on the connection's event loop.
+    template <typename T = void>
+    class task {
+    public:
+        // Typedef
+
+        struct promise_type: public task_result<T> {
+            // Member Fields
+
+            std::coroutine_handle<> continuation;
+            bool                    detached = false;
+            std::exception_ptr      exception;
+
+            // Member Functions
+
+            auto                final_suspend() noexcept {
+                struct awaiter {
+                    bool                    await_ready() noexcept {
+                        return false;
+                    }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        promise_type& promise = handle.promise();
+
+                        if (promise.continuation)
+                            return promise.continuation;
+
+                        if (promise.detached) {
+                            // Nobody is left to rethrow to
+                            if (promise.exception) {
+                                try {
+                                    std::rethrow_exception(promise.exception);
+                                } catch (std::exception& e) {
+                                    logger::error(e.what());
+                                } catch (...) { }
+                            }
+
+                            handle.destroy();
+                        }
+
+                        return std::noop_coroutine();
+                    }
+
+                    void                    await_resume() noexcept { }
+                };
+
+                return awaiter();
+            }
+
+            task                get_return_object() {
+                return task(std::coroutine_handle<promise_type>::from_promise(* this));
+            }
+
+            std::suspend_always initial_suspend() noexcept {
+                return { };
+            }
+
+            void                unhandled_exception() {
+                this->exception = std::current_exception();
+            }
+        };
+
+        // Constructors
+
+        task(task&& other) noexcept {
+            this->_handle = std::exchange(other._handle, nullptr);
+        }
+
+        task(const task&) = delete;
+
+        ~task() {
+            if (this->_handle)
+                this->_handle.destroy();
+        }
+
+        // Member Functions
+
+        auto operator co_await() && noexcept {
+            struct awaiter {
+                // Member Fields
+
+                std::coroutine_handle<promise_type> handle;
+
+                // Member Functions
+
+                bool                    await_ready() noexcept {
+                    return !this->handle || this->handle.done();
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                    this->handle.promise().continuation = continuation;
+
+                    return this->handle;
+                }
+
+                T                       await_resume() {
+                    promise_type& promise = this->handle.promise();
+
+                    if (promise.exception)
+                        std::rethrow_exception(promise.exception);
+
+                    return promise.result();
+                }
+            };
+
+            return awaiter { this->_handle };
+        }
+
+        // Runs the task to its first suspension; it frees itself when done
+        void detach() {
+            std::coroutine_handle<promise_type> handle = std::exchange(this->_handle, nullptr);
+
+            handle.promise().detached = true;
+            handle.resume();
+        }
+
+        task& operator=(const task&) = delete;
+    private:
+        // Constructors
+
+        task(const std::coroutine_handle<promise_type> handle) {
+            this->_handle = handle;
+        }
+
+        // Member Fields
+
+        std::coroutine_handle<promise_type> _handle;
+    };
+}
+
+#endif /* task_h */
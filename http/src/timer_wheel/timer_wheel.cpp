@@ -0,0 +1,161 @@
+//
+//  timer_wheel.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "timer_wheel.h"
+
+namespace mysocket {
+    // Constructors
+
+    timer_wheel::timer_wheel() {
+        this->_now = _clock();
+
+        for (size_t i = 0; i < LEVELS; i++)
+            for (size_t j = 0; j < SLOTS; j++)
+                this->_slots[i][j]._next = this->_slots[i][j]._prev = &this->_slots[i][j];
+    }
+
+    timer_wheel::timer::timer() { }
+
+    timer_wheel::timer::timer(const std::function<void()> callback) {
+        this->callback = callback;
+    }
+
+    // Member Functions
+
+    uint64_t timer_wheel::_clock() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void timer_wheel::_link(timer* timer) {
+        // The level is that of the highest digit in which expiry and now differ; it cascades down as now catches up
+        uint64_t difference = timer->_expiry ^ this->_now;
+        size_t   level = 0;
+
+        while (level < LEVELS - 1 && difference >> (SLOT_BITS * (level + 1)))
+            level++;
+
+        size_t slot = (timer->_expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+        // Beyond the wheel; park in the top level's last slot of the cycle and re-link when it cascades
+        if (difference >> (SLOT_BITS * LEVELS))
+            slot = ((this->_now >> (SLOT_BITS * level)) - 1) & (SLOTS - 1);
+
+        struct timer* head = &this->_slots[level][slot];
+
+        timer->_next = head;
+        timer->_prev = head->_prev;
+        head->_prev->_next = timer;
+        head->_prev = timer;
+    }
+
+    bool timer_wheel::timer::active() const {
+        return this->_next != NULL;
+    }
+
+    void timer_wheel::add(timer* timer, const size_t timeout) {
+        this->remove(timer);
+
+        // Due no earlier than the next tick
+        timer->_expiry = std::max(_clock() + timeout, this->_now + 1);
+
+        this->_link(timer);
+        this->_size++;
+    }
+
+    void timer_wheel::advance() {
+        uint64_t now = _clock();
+
+        if (this->_size == 0) {
+            this->_now = std::max(this->_now, now);
+
+            return;
+        }
+
+        while (this->_now < now) {
+            this->_now++;
+
+            // Move each level whose window just opened down a level, highest first
+            for (size_t level = LEVELS - 1; level > 0; level--) {
+                if (this->_now & ((1ULL << (SLOT_BITS * level)) - 1))
+                    continue;
+
+                timer* head = &this->_slots[level][(this->_now >> (SLOT_BITS * level)) & (SLOTS - 1)];
+
+                while (head->_next != head) {
+                    timer* timer = head->_next;
+
+                    head->_next = timer->_next;
+                    timer->_next->_prev = head;
+
+                    this->_link(timer);
+                }
+            }
+
+            // Detach the due slot first so callbacks can add and remove freely
+            timer  due;
+            timer* head = &this->_slots[0][this->_now & (SLOTS - 1)];
+
+            if (head->_next == head)
+                continue;
+
+            due._next = head->_next;
+            due._prev = head->_prev;
+            due._next->_prev = &due;
+            due._prev->_next = &due;
+            head->_next = head->_prev = head;
+
+            while (due._next != &due) {
+                timer* timer = due._next;
+
+                this->remove(timer);
+
+                timer->callback();
+            }
+        }
+    }
+
+    int timer_wheel::next_timeout() const {
+        if (this->_size == 0)
+            return -1;
+
+        // Walk the slots in the order they come due or cascade, stopping at the first occupied one
+        uint64_t tick = this->_now + 1;
+
+        for (size_t level = 0; level < LEVELS; level++) {
+            size_t shift = SLOT_BITS * level;
+
+            for (; (tick >> shift) & (SLOTS - 1); tick += 1ULL << shift) {
+                const timer* head = &this->_slots[level][(tick >> shift) & (SLOTS - 1)];
+
+                if (head->_next != head)
+                    break;
+            }
+
+            if ((tick >> shift) & (SLOTS - 1))
+                break;
+        }
+
+        uint64_t now = _clock();
+
+        return tick > now ? (int) (tick - now) : 0;
+    }
+
+    void timer_wheel::remove(timer* timer) {
+        if (!timer->active())
+            return;
+
+        timer->_prev->_next = timer->_next;
+        timer->_next->_prev = timer->_prev;
+        timer->_next = timer->_prev = NULL;
+
+        this->_size--;
+    }
+
+    size_t timer_wheel::size() const {
+        return this->_size;
+    }
+}
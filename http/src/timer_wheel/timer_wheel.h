@@ -0,0 +1,87 @@
+//
+//  timer_wheel.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef timer_wheel_h
+#define timer_wheel_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace mysocket {
+    // Hierarchical timing wheel with millisecond ticks: O(1) add, remove and re-add.
+    // Not thread-safe; owned and driven by a single event loop.
+    struct timer_wheel {
+        // Typedef
+
+        struct timer {
+            // Constructors
+
+            timer();
+
+            timer(const std::function<void()> callback);
+
+            // Member Fields
+
+            std::function<void()> callback;
+
+            // Member Functions
+
+            bool                  active() const;
+        private:
+            // Member Fields
+
+            uint64_t              _expiry = 0;
+            timer*                _next = NULL;
+            timer*                _prev = NULL;
+        public:
+            // Typdef
+
+            friend timer_wheel;
+        };
+
+        // Constructors
+
+        timer_wheel();
+
+        // Member Functions
+
+        // Arms the timer to fire after timeout milliseconds, re-arming it if already active
+        void   add(timer* timer, const size_t timeout);
+
+        // Runs every timer that has come due
+        void   advance();
+
+        // Milliseconds until the loop must call advance(); -1 if no timer is active
+        int    next_timeout() const;
+
+        void   remove(timer* timer);
+
+        size_t size() const;
+    private:
+        // Member Fields
+
+        static const size_t LEVELS = 4;
+        static const size_t SLOT_BITS = 6;
+        static const size_t SLOTS = 1 << SLOT_BITS;
+
+        // Last tick processed
+        uint64_t            _now;
+        size_t              _size = 0;
+        // Sentinels of circular lists; level n holds timers due within 64^(n + 1) ticks
+        timer               _slots[LEVELS][SLOTS];
+
+        // Member Functions
+
+        static uint64_t     _clock();
+
+        void                _link(timer* timer);
+    };
+}
+
+#endif /* timer_wheel_h */
@@ -0,0 +1,217 @@
+//
+//  tls.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "socket.h"
+
+#if TLS
+
+#include <openssl/core_names.h>
+#include <openssl/rand.h>
+
+namespace mysocket {
+    // Non-Member Functions
+
+    // Oldest queued OpenSSL error, and clears the queue
+    std::string _tls_error() {
+        char buff[256] = "TLS error";
+
+        unsigned long code = ERR_get_error();
+
+        if (code)
+            ERR_error_string_n(code, buff, sizeof(buff));
+
+        ERR_clear_error();
+
+        return std::string(buff);
+    }
+
+    // Constructors
+
+    tls_context::tls_context(const struct options options) {
+        this->_options = options;
+        this->_context = SSL_CTX_new(TLS_server_method());
+
+        if (this->_context == NULL)
+            throw mysocket::error(ENOMEM, _tls_error());
+
+        SSL_CTX_set_app_data(this->_context, this);
+        SSL_CTX_set_min_proto_version(this->_context, TLS1_2_VERSION);
+
+        // Event loops resume short writes from the same queue, which may have grown in the meantime;
+        // idle connections give their record buffers back
+        SSL_CTX_set_mode(this->_context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+
+        if (SSL_CTX_use_certificate_chain_file(this->_context, options.certificate.c_str()) != 1 ||
+            SSL_CTX_use_PrivateKey_file(this->_context, options.private_key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_check_private_key(this->_context) != 1) {
+            std::string what = _tls_error();
+
+            SSL_CTX_free(this->_context);
+
+            throw mysocket::error(EINVAL, what);
+        }
+
+        // One cache for every loop; OpenSSL locks it
+        SSL_CTX_set_session_cache_mode(this->_context, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(this->_context, options.session_cache_size);
+        SSL_CTX_set_timeout(this->_context, options.session_timeout);
+        SSL_CTX_set_session_id_context(this->_context, (const unsigned char *)"http", 4);
+
+        if (options.ticket_rotation)
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(this->_context, _ticket);
+        else
+            // TLS 1.3 then issues stateful tickets, which name a session in the cache
+            SSL_CTX_set_options(this->_context, SSL_OP_NO_TICKET);
+
+#if defined(SSL_OP_IGNORE_UNEXPECTED_EOF)
+        // Most clients close without close_notify; HTTP framing already catches a truncated message
+        SSL_CTX_set_options(this->_context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+#if defined(SSL_OP_ENABLE_KTLS)
+        // Takes effect per connection, where the kernel has the tls module and supports the negotiated cipher
+        if (options.ktls)
+            SSL_CTX_set_options(this->_context, SSL_OP_ENABLE_KTLS);
+#endif
+    }
+
+    tls_context::~tls_context() { }
+
+    // Member Functions
+
+    SSL* tls_context::_accept(const int file_descriptor) {
+        SSL* ssl = SSL_new(this->_context);
+
+        if (ssl == NULL)
+            return NULL;
+
+        if (SSL_set_fd(ssl, file_descriptor) != 1) {
+            SSL_free(ssl);
+
+            return NULL;
+        }
+
+        SSL_set_accept_state(ssl);
+
+        return ssl;
+    }
+
+    void tls_context::_failed() {
+        this->_failures.fetch_add(1);
+
+        ERR_clear_error();
+    }
+
+    void tls_context::_handshaken(SSL* ssl) {
+        if (SSL_session_reused(ssl))
+            this->_resumed.fetch_add(1);
+        else
+            this->_full.fetch_add(1);
+
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl)))
+            this->_ktls_send.fetch_add(1);
+
+        if (BIO_get_ktls_recv(SSL_get_rbio(ssl)))
+            this->_ktls_recv.fetch_add(1);
+    }
+
+    void tls_context::_rotate() {
+        time_t now = time(NULL);
+
+        if (this->_keys.empty() || now - this->_keys.front().created >= this->_options.ticket_rotation) {
+            ticket_key key;
+
+            key.created = now;
+
+            // Keep issuing with the current key rather than fail handshakes
+            if (RAND_bytes(key.name, sizeof(key.name)) == 1 &&
+                RAND_bytes(key.aes_key, sizeof(key.aes_key)) == 1 &&
+                RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) == 1) {
+                if (this->_keys.size())
+                    this->_ticket_rotations.fetch_add(1);
+
+                this->_keys.push_front(key);
+            }
+        }
+
+        // The previous key is honored until it is twice the rotation old
+        while (this->_keys.size() > 2 || (this->_keys.size() > 1 && now - this->_keys.back().created >= this->_options.ticket_rotation * 2))
+            this->_keys.pop_back();
+    }
+
+    int tls_context::_ticket(SSL* ssl, unsigned char name[16], unsigned char iv[EVP_MAX_IV_LENGTH], EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt) {
+        tls_context*                context = (tls_context *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+        std::lock_guard<std::mutex> lock(context->_keys_mutex);
+
+        context->_rotate();
+
+        auto init_mac = [mac](ticket_key& key) {
+            OSSL_PARAM params[] = {
+                OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key)),
+                OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0),
+                OSSL_PARAM_construct_end()
+            };
+
+            return EVP_MAC_CTX_set_params(mac, params) == 1;
+        };
+
+        if (encrypt) {
+            // No key yet; the session stays resumable from the cache
+            if (context->_keys.empty())
+                return 0;
+
+            ticket_key& key = context->_keys.front();
+
+            if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+                return -1;
+
+            memcpy(name, key.name, sizeof(key.name));
+
+            if (EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aes_key, iv) != 1 || !init_mac(key))
+                return -1;
+
+            return 1;
+        }
+
+        for (size_t i = 0; i < context->_keys.size(); i++) {
+            ticket_key& key = context->_keys[i];
+
+            if (memcmp(name, key.name, sizeof(key.name)))
+                continue;
+
+            if (EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aes_key, iv) != 1 || !init_mac(key))
+                return -1;
+
+            // Issued under the previous key; resume, and hand the client a fresh ticket
+            return i ? 2 : 1;
+        }
+
+        // Retired or forged; a full handshake follows
+        return 0;
+    }
+
+    void tls_context::close() {
+        SSL_CTX_free(this->_context);
+
+        delete this;
+    }
+
+    struct tls_context::statistics tls_context::stats() const {
+        struct statistics result;
+
+        result.failures = this->_failures.load();
+        result.full = this->_full.load();
+        result.ktls_recv = this->_ktls_recv.load();
+        result.ktls_send = this->_ktls_send.load();
+        result.resumed = this->_resumed.load();
+        result.ticket_rotations = this->_ticket_rotations.load();
+
+        return result;
+    }
+}
+
+#endif
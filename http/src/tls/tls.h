@@ -0,0 +1,118 @@
+//
+//  tls.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef tls_h
+#define tls_h
+
+#include "properties.h"
+
+#if TLS
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <string>
+
+namespace mysocket {
+    // Server-side TLS (OpenSSL 3): certificate and key, one session cache shared by every loop, and session ticket
+    // keys rotated on a schedule, so returning clients resume instead of repeating the full handshake
+    struct tls_context {
+        // Typedef
+
+        struct options {
+            // PEM: the certificate, followed by any intermediates
+            std::string certificate;
+            // Linux: after the handshake, hand record encryption to the kernel where it supports the cipher (kTLS),
+            // so sends skip OpenSSL and stay zero-copy
+            bool        ktls = true;
+            // PEM
+            std::string private_key;
+            // Sessions kept for resumption by id, shared by every connection; 0 for no limit
+            long        session_cache_size = 20480;
+            // Seconds a session stays resumable
+            long        session_timeout = 7200;
+            // Seconds each ticket key issues tickets; the previous key is still honored for as long again, and its
+            // tickets are renewed. 0 to issue no tickets, and resume from the session cache alone
+            long        ticket_rotation = 3600;
+        };
+
+        struct statistics {
+            // Handshakes that failed, or that the peer abandoned
+            size_t failures = 0;
+            // Full handshakes; the expensive ones
+            size_t full = 0;
+            // Connections whose sends the kernel encrypts
+            size_t ktls_send = 0;
+            // Connections whose receives the kernel decrypts
+            size_t ktls_recv = 0;
+            // Abbreviated handshakes, from the session cache or a ticket; over full + resumed, the resumption ratio
+            size_t resumed = 0;
+            size_t ticket_rotations = 0;
+        };
+
+        // Constructors
+
+        tls_context(const struct options options);
+
+        // Member Functions
+
+        // Once every server using it has closed
+        void              close();
+
+        struct statistics stats() const;
+    private:
+        // Typedef
+
+        struct ticket_key {
+            unsigned char aes_key[32];
+            time_t        created;
+            unsigned char hmac_key[32];
+            unsigned char name[16];
+        };
+
+        friend struct tcp_server;
+
+        // Constructors
+
+        ~tls_context();
+
+        // Member Fields
+
+        SSL_CTX*                _context = NULL;
+        std::atomic<size_t>     _failures = 0;
+        std::atomic<size_t>     _full = 0;
+        std::atomic<size_t>     _ktls_recv = 0;
+        std::atomic<size_t>     _ktls_send = 0;
+        // Newest first
+        std::deque<ticket_key>  _keys;
+        std::mutex              _keys_mutex;
+        struct options          _options;
+        std::atomic<size_t>     _resumed = 0;
+        std::atomic<size_t>     _ticket_rotations = 0;
+
+        // Member Functions
+
+        // A server-side session over the socket; NULL on failure
+        SSL*              _accept(const int file_descriptor);
+
+        void              _failed();
+
+        // Counts the finished handshake, by kind and offload
+        void              _handshaken(SSL* ssl);
+
+        // Issues a new ticket key once the current one is due, and forgets keys past their grace period. Caller holds _keys_mutex
+        void              _rotate();
+
+        static int        _ticket(SSL* ssl, unsigned char name[16], unsigned char iv[EVP_MAX_IV_LENGTH], EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt);
+    };
+}
+
+#endif
+
+#endif /* tls_h */
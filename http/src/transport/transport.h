@@ -0,0 +1,39 @@
+//
+//  transport.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef transport_h
+#define transport_h
+
+#include <functional>
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // iovec
+
+namespace mysocket {
+    // Byte stream a tcp_server::connection can run over in place of a socket; see tcp_server::open()
+    struct transport {
+        // Constructors
+
+        virtual ~transport() { }
+
+        // Member Functions
+
+        // Stops both ways: the peer reads what is left, then end of stream, and its sends fail with EPIPE
+        virtual void    close() = 0;
+
+        // Runs, on any thread, with event_loop::READABLE once recv() may have more, or WRITABLE once send() may take
+        // more, after either failed with EAGAIN; nullptr to stop. Once this returns, the callback it replaced never runs again
+        virtual void    on_ready(const std::function<void(const int events)> callback) = 0;
+
+        // Never blocks: the bytes read, -1 with errno EAGAIN when there are none yet, or 0 once the peer has closed
+        virtual ssize_t recv(char* data, const size_t len) = 0;
+
+        // Never blocks: the bytes taken, in order, -1 with errno EAGAIN when there is no room, or EPIPE once the peer has closed
+        virtual ssize_t send(const struct iovec* iov, const size_t count) = 0;
+    };
+}
+
+#endif /* transport_h */
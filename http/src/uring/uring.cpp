@@ -0,0 +1,380 @@
+//
+//  uring.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "uring.h"
+
+#ifdef __linux__
+
+#include "socket.h"
+
+namespace mysocket {
+    // Non-Member Fields
+
+    // Group id for provided receive buffers
+    const unsigned short BUFFER_GROUP = 0;
+
+    // Non-Member Functions
+
+    int _io_uring_enter(const int file_descriptor, const unsigned to_submit, const unsigned min_complete, const unsigned flags, const void* arg, const size_t argsz) {
+        return (int) syscall(__NR_io_uring_enter, file_descriptor, to_submit, min_complete, flags, arg, argsz);
+    }
+
+    int _io_uring_setup(const unsigned entries, struct io_uring_params* params) {
+        return (int) syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    // Constructors
+
+    uring::uring(const unsigned entries) {
+        struct io_uring_params params;
+
+        memset(&params, 0, sizeof(params));
+
+        // Multishot accept and receive post many completions per submission
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+
+        this->_file_descriptor = _io_uring_setup(entries, &params);
+
+        if (this->_file_descriptor == -1)
+            throw mysocket::error(errno);
+
+        this->_features = params.features;
+        this->_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            this->_sq_size = this->_cq_size = std::max(this->_sq_size, this->_cq_size);
+
+        this->_sq_ptr = mmap(0, this->_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_file_descriptor, IORING_OFF_SQ_RING);
+
+        if (this->_sq_ptr != MAP_FAILED)
+            this->_cq_ptr = params.features & IORING_FEAT_SINGLE_MMAP ?
+                this->_sq_ptr :
+                mmap(0, this->_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_file_descriptor, IORING_OFF_CQ_RING);
+
+        if (this->_cq_ptr != MAP_FAILED)
+            this->_sqes = (struct io_uring_sqe *)mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_file_descriptor, IORING_OFF_SQES);
+
+        if (this->_sqes == MAP_FAILED) {
+            int errnum = errno;
+
+            this->_unmap();
+
+            ::close(this->_file_descriptor);
+
+            throw mysocket::error(errnum);
+        }
+
+        char* sq = (char *)this->_sq_ptr;
+        char* cq = (char *)this->_cq_ptr;
+
+        this->_sq_entries = params.sq_entries;
+        this->_sq_head = (unsigned *)(sq + params.sq_off.head);
+        this->_sq_tail = (unsigned *)(sq + params.sq_off.tail);
+        this->_sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+        this->_sq_array = (unsigned *)(sq + params.sq_off.array);
+        this->_sq_local_tail = *this->_sq_tail;
+        this->_cq_head = (unsigned *)(cq + params.cq_off.head);
+        this->_cq_tail = (unsigned *)(cq + params.cq_off.tail);
+        this->_cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+        this->_cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    }
+
+    uring::~uring() { }
+
+    // Member Functions
+
+    struct io_uring_sqe* uring::_sqe() {
+        // Ring full; hand what we have to the kernel first
+        if (this->_sq_full())
+            this->submit(false);
+
+        // Still full: the kernel takes no more until completions are reaped (EBUSY). Set them aside and try again;
+        // never overwrite an entry it has not consumed
+        if (this->_sq_full()) {
+            this->_stash();
+            this->submit(false);
+
+            if (this->_sq_full())
+                throw mysocket::error(EBUSY);
+        }
+
+        unsigned             index = this->_sq_local_tail & *this->_sq_mask;
+        struct io_uring_sqe* sqe = &this->_sqes[index];
+
+        memset(sqe, 0, sizeof(* sqe));
+
+        this->_sq_array[index] = index;
+        this->_sq_local_tail++;
+        this->_pending++;
+
+        return sqe;
+    }
+
+    bool uring::_sq_full() const {
+        return this->_sq_local_tail - __atomic_load_n(this->_sq_head, __ATOMIC_ACQUIRE) >= this->_sq_entries;
+    }
+
+    size_t uring::_stash() {
+        unsigned head = *this->_cq_head;
+        unsigned start = head;
+
+        while (head != __atomic_load_n(this->_cq_tail, __ATOMIC_ACQUIRE))
+            this->_stashed.push_back(this->_cqes[head++ & *this->_cq_mask]);
+
+        __atomic_store_n(this->_cq_head, head, __ATOMIC_RELEASE);
+
+        return head - start;
+    }
+
+    void uring::_unmap() {
+        if (this->_sqes != MAP_FAILED)
+            munmap(this->_sqes, this->_sq_entries * sizeof(struct io_uring_sqe));
+
+        if (this->_cq_ptr != MAP_FAILED && this->_cq_ptr != this->_sq_ptr)
+            munmap(this->_cq_ptr, this->_cq_size);
+
+        if (this->_sq_ptr != MAP_FAILED)
+            munmap(this->_sq_ptr, this->_sq_size);
+    }
+
+    char* uring::buffer(const unsigned short id) {
+        return this->_buffers.data() + id * this->_buffer_size;
+    }
+
+    size_t uring::buffer_size() const {
+        return this->_buffer_size;
+    }
+
+    void uring::close() {
+        this->_unmap();
+
+        ::close(this->_file_descriptor);
+
+        delete this;
+    }
+
+    void uring::completions(const std::function<void(const struct io_uring_cqe*)> callback) {
+        while (true) {
+            struct io_uring_cqe cqe;
+
+            // Stashed ones are older than any left on the ring. Either may grow during a callback that queues more
+            // work, so both are checked afresh each time
+            if (this->_stashed.size()) {
+                cqe = this->_stashed.front();
+
+                this->_stashed.pop_front();
+            } else {
+                unsigned head = *this->_cq_head;
+
+                if (head == __atomic_load_n(this->_cq_tail, __ATOMIC_ACQUIRE))
+                    return;
+
+                cqe = this->_cqes[head & *this->_cq_mask];
+
+                // Release the slot before the callback so the kernel can keep posting
+                __atomic_store_n(this->_cq_head, head + 1, __ATOMIC_RELEASE);
+            }
+
+            this->_completions.fetch_add(1, std::memory_order_relaxed);
+
+            callback(&cqe);
+        }
+    }
+
+    void uring::prep_accept(const int file_descriptor, const bool multishot, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = file_descriptor;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = (__u64)user_data;
+
+        if (multishot)
+            sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+    }
+
+    void uring::prep_cancel(void* target) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (__u64)target;
+    }
+
+    void uring::prep_poll(const int file_descriptor, const short events, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = file_descriptor;
+        sqe->poll32_events = events;
+        sqe->user_data = (__u64)user_data;
+    }
+
+    void uring::prep_recv(const int file_descriptor, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        // The kernel picks a buffer from the group once data is ready; idle receives hold none
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = file_descriptor;
+        sqe->len = (__u32)this->_buffer_size;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = (__u64)user_data;
+    }
+
+    void uring::prep_send(const int file_descriptor, const char* buff, const size_t len, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = file_descriptor;
+        sqe->addr = (__u64)buff;
+        sqe->len = (__u32)len;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = (__u64)user_data;
+    }
+
+    void uring::prep_sendmsg(const int file_descriptor, const struct msghdr* message, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = file_descriptor;
+        sqe->addr = (__u64)message;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = (__u64)user_data;
+    }
+
+    void uring::prep_send_zc(const int file_descriptor, const char* buff, const size_t len, void* user_data) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->fd = file_descriptor;
+        sqe->addr = (__u64)buff;
+        sqe->len = (__u32)len;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->ioprio = IORING_SEND_ZC_REPORT_USAGE;
+        sqe->user_data = (__u64)user_data;
+    }
+
+    void uring::provide_buffers(const size_t count, const size_t size) {
+        this->_buffers.resize(count * size);
+        this->_buffer_size = size;
+
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = (__s32)count;
+        sqe->addr = (__u64)this->_buffers.data();
+        sqe->len = (__u32)size;
+        sqe->off = 0;
+        sqe->buf_group = BUFFER_GROUP;
+    }
+
+    void uring::release_buffer(const unsigned short id) {
+        struct io_uring_sqe* sqe = this->_sqe();
+
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;
+        sqe->addr = (__u64)this->buffer(id);
+        sqe->len = (__u32)this->_buffer_size;
+        sqe->off = id;
+        sqe->buf_group = BUFFER_GROUP;
+    }
+
+    struct uring::statistics uring::stats() const {
+        struct statistics result;
+
+        result.completions = this->_completions.load(std::memory_order_relaxed);
+        result.enters = this->_enters.load(std::memory_order_relaxed);
+        result.submissions = this->_submissions.load(std::memory_order_relaxed);
+
+        return result;
+    }
+
+    void uring::submit(const bool wait, const int timeout) {
+        // Not while completions are already waiting to be handed out
+        const bool                    block = wait && this->_stashed.empty();
+        struct __kernel_timespec      ts = { timeout / 1000, (timeout % 1000) * 1000000LL };
+        struct io_uring_getevents_arg arg;
+        unsigned                      flags = block ? IORING_ENTER_GETEVENTS : 0;
+
+        memset(&arg, 0, sizeof(arg));
+
+        if (block && timeout >= 0) {
+            if (this->_features & IORING_FEAT_EXT_ARG) {
+                arg.ts = (__u64)&ts;
+                flags |= IORING_ENTER_EXT_ARG;
+            } else {
+                // Older kernels: a timeout that also completes with the first other completion
+                struct io_uring_sqe* sqe = this->_sqe();
+
+                this->_timeout = ts;
+
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->fd = -1;
+                sqe->addr = (__u64)&this->_timeout;
+                sqe->len = 1;
+                sqe->off = 1;
+            }
+        }
+
+        __atomic_store_n(this->_sq_tail, this->_sq_local_tail, __ATOMIC_RELEASE);
+
+        if (!this->_pending && !block)
+            return;
+
+        int result = flags & IORING_ENTER_EXT_ARG ?
+            _io_uring_enter(this->_file_descriptor, this->_pending, 1, flags, &arg, sizeof(arg)) :
+            _io_uring_enter(this->_file_descriptor, this->_pending, block ? 1 : 0, flags, NULL, 0);
+
+        this->_enters.fetch_add(1, std::memory_order_relaxed);
+
+        if (result == -1) {
+            // Interrupted, timed out, or completions must be reaped before more can be submitted
+            if (errno == EINTR || errno == ETIME || errno == EBUSY || errno == EAGAIN)
+                return;
+
+            throw mysocket::error(errno);
+        }
+
+        this->_pending -= result;
+        this->_submissions.fetch_add(result, std::memory_order_relaxed);
+    }
+
+    bool uring::supported() {
+        static const bool result = []() {
+            struct io_uring_params params;
+
+            memset(&params, 0, sizeof(params));
+
+            int file_descriptor = _io_uring_setup(4, &params);
+
+            if (file_descriptor == -1)
+                return false;
+
+            const size_t           nops = 256;
+            std::vector<char>      buff(sizeof(struct io_uring_probe) + nops * sizeof(struct io_uring_probe_op), 0);
+            struct io_uring_probe* probe = (struct io_uring_probe *)buff.data();
+            bool                   result = params.features & IORING_FEAT_FAST_POLL &&
+                syscall(__NR_io_uring_register, file_descriptor, IORING_REGISTER_PROBE, probe, nops) == 0;
+
+            for (int op: { IORING_OP_ACCEPT, IORING_OP_ASYNC_CANCEL, IORING_OP_POLL_ADD, IORING_OP_PROVIDE_BUFFERS, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SENDMSG, IORING_OP_TIMEOUT })
+                if (result && !(op <= probe->last_op && probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                    result = false;
+
+            ::close(file_descriptor);
+
+            return result;
+        }();
+
+        return result;
+    }
+}
+
+#endif
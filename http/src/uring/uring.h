@@ -0,0 +1,128 @@
+//
+//  uring.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef uring_h
+#define uring_h
+
+#ifdef __linux__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <linux/io_uring.h>
+#include <sys/mman.h>       // mmap, munmap
+#include <sys/socket.h>     // msghdr
+#include <sys/syscall.h>    // SYS_io_uring_*
+#include <unistd.h>         // close, syscall
+#include <vector>
+
+namespace mysocket {
+    // Minimal io_uring ring over the raw system calls (no liburing dependency)
+    struct uring {
+        // Typedef
+
+        struct statistics {
+            size_t completions = 0;
+            // io_uring_enter calls; compare against submissions for the syscall saving
+            size_t enters = 0;
+            size_t submissions = 0;
+        };
+
+        // Constructors
+
+        uring(const unsigned entries);
+
+        // Member Functions
+
+        char*                buffer(const unsigned short id);
+
+        size_t               buffer_size() const;
+
+        void                 close();
+
+        void                 completions(const std::function<void(const struct io_uring_cqe*)> callback);
+
+        void                 prep_accept(const int file_descriptor, const bool multishot, void* user_data);
+
+        void                 prep_cancel(void* target);
+
+        void                 prep_poll(const int file_descriptor, const short events, void* user_data);
+
+        void                 prep_recv(const int file_descriptor, void* user_data);
+
+        void                 prep_send(const int file_descriptor, const char* buff, const size_t len, void* user_data);
+
+        // The header and its iovecs must stay put until the completion
+        void                 prep_sendmsg(const int file_descriptor, const struct msghdr* message, void* user_data);
+
+        // Sends from the buffer in place: a second completion, flagged IORING_CQE_F_NOTIF, follows once the kernel is
+        // done with it. Its result reports IORING_NOTIF_USAGE_ZC_COPIED if the kernel copied after all
+        void                 prep_send_zc(const int file_descriptor, const char* buff, const size_t len, void* user_data);
+
+        void                 provide_buffers(const size_t count, const size_t size);
+
+        void                 release_buffer(const unsigned short id);
+
+        struct statistics    stats() const;
+
+        // Waits, if asked, for at least one completion, or until timeout milliseconds pass (-1 for no limit)
+        void                 submit(const bool wait, const int timeout = -1);
+
+        static bool          supported();
+    private:
+        // Constructors
+
+        ~uring();
+
+        // Member Fields
+
+        std::vector<char>    _buffers;
+        size_t               _buffer_size = 0;
+        // Statistics are counted on the loop thread and read from any
+        std::atomic<size_t>  _completions = 0;
+        struct io_uring_cqe* _cqes;
+        unsigned*            _cq_head;
+        unsigned*            _cq_mask;
+        void*                _cq_ptr = MAP_FAILED;
+        size_t               _cq_size;
+        unsigned*            _cq_tail;
+        std::atomic<size_t>  _enters = 0;
+        unsigned             _features = 0;
+        int                  _file_descriptor;
+        unsigned             _pending = 0;
+        unsigned*            _sq_array;
+        unsigned             _sq_entries;
+        unsigned*            _sq_head;
+        unsigned             _sq_local_tail;
+        unsigned*            _sq_mask;
+        void*                _sq_ptr = MAP_FAILED;
+        size_t               _sq_size;
+        unsigned*            _sq_tail;
+        struct io_uring_sqe* _sqes = (struct io_uring_sqe *)MAP_FAILED;
+        // Completions reaped early by _sqe() to make room; completions() hands them out first
+        std::deque<struct io_uring_cqe> _stashed;
+        std::atomic<size_t>  _submissions = 0;
+        // Read by the kernel when a timeout operation is submitted
+        struct __kernel_timespec _timeout;
+
+        // Member Functions
+
+        struct io_uring_sqe* _sqe();
+
+        // Every submission queue entry is written and not yet consumed by the kernel
+        bool                 _sq_full() const;
+
+        // Moves the completions posted so far off the ring; returns how many
+        size_t               _stash();
+
+        void                 _unmap();
+    };
+}
+
+#endif
+
+#endif /* uring_h */
@@ -126,7 +126,15 @@ std::string join(std::vector<std::string> values, std::string delimeter) {
 }
 
 int parse_int(const std::string value) {
-    return is_int(value) ? stoi(value) : INT_MIN;
+    if (!is_int(value))
+        return INT_MIN;
+
+    try {
+        return stoi(value);
+    } catch (std::out_of_range& e) {
+        // Digits, but too many for an int
+        return INT_MIN;
+    }
 }
 
 double parse_number(const std::string value) {
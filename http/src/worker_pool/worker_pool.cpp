@@ -0,0 +1,200 @@
+//
+//  worker_pool.cpp
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#include "worker_pool.h"
+#include "logger.h"
+
+namespace mysocket {
+    // Non-Member Fields
+
+    // Pool and index of the worker running on this thread, if any
+    thread_local worker_pool* _current_pool = NULL;
+    thread_local size_t       _current_worker = 0;
+
+    // Constructors
+
+    worker_pool::worker_pool(const size_t threads, const bool prespawn) {
+        size_t nthreads = threads ? threads : std::max(std::thread::hardware_concurrency(), 1U);
+
+        for (size_t i = 0; i < nthreads; i++)
+            this->_workers.push_back(new worker());
+
+        if (!prespawn)
+            return;
+
+        this->_mutex.lock();
+
+        while (this->_spawned < this->_workers.size())
+            this->_spawn();
+
+        this->_mutex.unlock();
+    }
+
+    worker_pool::~worker_pool() { }
+
+    // Member Functions
+
+    void worker_pool::_run(const size_t index) {
+        _current_pool = this;
+        _current_worker = index;
+
+        std::function<void()> task;
+
+        while (true) {
+            if (this->_take(index, task)) {
+                try {
+                    task();
+                } catch (std::exception& e) {
+                    logger::error(e.what());
+                }
+
+                task = nullptr;
+
+                this->_completed.fetch_add(1, std::memory_order_relaxed);
+
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(this->_mutex);
+
+            // Announce before checking, so a concurrent submit() either sees us or we see its task
+            this->_idle++;
+
+            if (this->_pending.load() == 0 && this->_stopping) {
+                // Drained
+                this->_idle--;
+
+                return;
+            }
+
+            this->_condition.wait(lock, [this]() {
+                return this->_pending.load() || this->_stopping;
+            });
+            this->_idle--;
+        }
+    }
+
+    void worker_pool::_spawn() {
+        size_t index = this->_spawned++;
+
+        this->_workers[index]->thread = std::thread([this, index]() {
+            this->_run(index);
+        });
+    }
+
+    bool worker_pool::_take(const size_t index, std::function<void()>& task) {
+        worker* worker = this->_workers[index];
+
+        worker->mutex.lock();
+
+        // Newest first; it is the most likely to still be in cache
+        if (worker->tasks.size()) {
+            task = std::move(worker->tasks.back());
+
+            worker->tasks.pop_back();
+            worker->mutex.unlock();
+
+            this->_pending.fetch_sub(1);
+
+            return true;
+        }
+
+        worker->mutex.unlock();
+
+        // Steal the oldest task of the next busy worker
+        for (size_t i = 1; i < this->_workers.size(); i++) {
+            struct worker* victim = this->_workers[(index + i) % this->_workers.size()];
+
+            victim->mutex.lock();
+
+            if (victim->tasks.empty()) {
+                victim->mutex.unlock();
+
+                continue;
+            }
+
+            task = std::move(victim->tasks.front());
+
+            victim->tasks.pop_front();
+            victim->mutex.unlock();
+
+            this->_pending.fetch_sub(1);
+            this->_steals.fetch_add(1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void worker_pool::close() {
+        this->_mutex.lock();
+
+        // Queued tasks on workers that never started still need a thread
+        if (this->_pending.load())
+            while (this->_spawned < this->_workers.size())
+                this->_spawn();
+
+        this->_stopping = true;
+        this->_condition.notify_all();
+        this->_mutex.unlock();
+
+        for (size_t i = 0; i < this->_spawned; i++)
+            this->_workers[i]->thread.join();
+
+        for (worker* worker: this->_workers)
+            delete worker;
+
+        delete this;
+    }
+
+    struct worker_pool::statistics worker_pool::stats() {
+        struct statistics result;
+
+        result.completed = this->_completed.load(std::memory_order_relaxed);
+        result.steals = this->_steals.load(std::memory_order_relaxed);
+
+        for (worker* worker: this->_workers) {
+            worker->mutex.lock();
+
+            result.depths.push_back(worker->tasks.size());
+
+            worker->mutex.unlock();
+
+            result.queued += result.depths.back();
+        }
+
+        result.threads = this->_spawned.load();
+
+        return result;
+    }
+
+    void worker_pool::submit(const std::function<void()> task) {
+        size_t index = _current_pool == this ?
+            _current_worker :
+            this->_next.fetch_add(1, std::memory_order_relaxed) % this->_workers.size();
+        worker* worker = this->_workers[index];
+
+        worker->mutex.lock();
+        worker->tasks.push_back(task);
+        worker->mutex.unlock();
+
+        this->_pending.fetch_add(1);
+
+        if (this->_idle.load() == 0 && this->_spawned.load() == this->_workers.size())
+            return;
+
+        this->_mutex.lock();
+
+        // Start another worker only when every running one is busy
+        if (this->_idle.load() == 0 && this->_spawned.load() < this->_workers.size())
+            this->_spawn();
+
+        this->_condition.notify_one();
+        this->_mutex.unlock();
+    }
+}
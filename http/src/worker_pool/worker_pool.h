@@ -0,0 +1,89 @@
+//
+//  worker_pool.h
+//  http
+//
+//  Created by Corey Ferguson on 10/18/26.
+//
+
+#ifndef worker_pool_h
+#define worker_pool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mysocket {
+    // Fixed-size pool of workers, each with its own deque: a worker takes its newest task first,
+    // and an idle one steals the oldest task of another before going to sleep
+    struct worker_pool {
+        // Typedef
+
+        struct statistics {
+            size_t              completed = 0;
+            // Tasks waiting, per worker; queued is their sum
+            std::vector<size_t> depths;
+            size_t              queued = 0;
+            // Tasks run by a worker other than the one they were queued on
+            size_t              steals = 0;
+            size_t              threads = 0;
+        };
+
+        // Constructors
+
+        // 0 threads for one per hardware thread; without prespawn, workers start as load first needs them
+        worker_pool(const size_t threads = 0, const bool prespawn = true);
+
+        // Member Functions
+
+        // Runs what is queued, then joins the workers
+        void              close();
+
+        struct statistics stats();
+
+        // From a worker, queues on its own deque; otherwise spreads tasks over the workers
+        void              submit(const std::function<void()> task);
+    private:
+        // Typedef
+
+        struct worker {
+            // Member Fields
+
+            std::mutex                        mutex;
+            std::deque<std::function<void()>> tasks;
+            std::thread                       thread;
+        };
+
+        // Constructors
+
+        ~worker_pool();
+
+        // Member Fields
+
+        std::atomic<size_t>     _completed = 0;
+        std::condition_variable _condition;
+        // Workers asleep or about to be; submit() only takes the lock when there is one to wake
+        std::atomic<size_t>     _idle = 0;
+        std::mutex              _mutex;
+        std::atomic<size_t>     _next = 0;
+        // Queued and not yet taken
+        std::atomic<size_t>     _pending = 0;
+        std::atomic<size_t>     _spawned = 0;
+        std::atomic<size_t>     _steals = 0;
+        bool                    _stopping = false;
+        std::vector<worker*>    _workers;
+
+        // Member Functions
+
+        void                    _run(const size_t index);
+
+        void                    _spawn();
+
+        bool                    _take(const size_t index, std::function<void()>& task);
+    };
+}
+
+#endif /* worker_pool_h */